@@ -0,0 +1,331 @@
+#include "common/common.hpp"
+#include "common/ChatRoom.hpp"
+#include "common/IoContextPool.hpp"
+#include "common/RecyclingPool.hpp"
+#include "common/Server.hpp"
+
+#include <sys/resource.h>
+
+// gcc pairs the malloc and free below, and asio's frame allocation, with the
+// operator new defined here and warns about every one of them
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+// What the server allocates per connection and per delivered message, with
+// the RecyclingPool off and on. Every allocation of the process goes through
+// the counting operator new below, only the ones on the server's threads are
+// counted, the clients and the main thread, which makes the messages, are
+// left out. Connections connect, shake hands and hang up; messages are
+// broadcast to receivers clients that stay connected. Every run is preceded
+// by one that isn't reported, so both settings start out warm
+// usage: allocation_bench [port] [connections] [receivers] [messages]
+
+namespace
+{
+
+std::atomic<u64> allocations = 0;
+thread_local bool counted = true;
+
+} // namespace
+
+auto operator new(std::size_t size) -> void*
+{
+  if (counted)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  if (void *block = std::malloc(size == 0 ? 1 : size))
+  {
+    return block;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *block) noexcept
+{
+  std::free(block);
+}
+
+void operator delete(void *block, [[maybe_unused]] std::size_t size) noexcept
+{
+  std::free(block);
+}
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::tcp;
+using WebSocket = beast::websocket::stream<tcp::socket>;
+
+struct Totals
+{
+  std::atomic<u32> connected = 0;
+  std::atomic<u32> failed = 0;
+  std::atomic<u64> bytes = 0;
+};
+
+auto Connect(WebSocket &socket, tcp::endpoint endpoint) -> awaitable<bool>
+{
+  try
+  {
+    co_await socket.next_layer().async_connect(endpoint, use_awaitable);
+    co_await socket.async_handshake("127.0.0.1", "/", use_awaitable);
+  }
+  catch (std::exception&)
+  {
+    co_return false;
+  }
+  co_return true;
+}
+
+// Connects, shakes hands and closes again right away
+awaitable<void> Churn(Totals &totals, tcp::endpoint endpoint)
+{
+  WebSocket socket(co_await asio::this_coro::executor);
+  if (!co_await Connect(socket, endpoint))
+  {
+    totals.failed.fetch_add(1, std::memory_order_relaxed);
+    co_return;
+  }
+  totals.connected.fetch_add(1, std::memory_order_relaxed);
+
+  boost::system::error_code ec;
+  co_await socket.async_close(
+    beast::websocket::close_code::normal,
+    asio::redirect_error(use_awaitable, ec));
+}
+
+// Stays connected and only counts the bytes it reads
+awaitable<void> Receiver(Totals &totals, tcp::endpoint endpoint)
+{
+  WebSocket socket(co_await asio::this_coro::executor);
+  if (!co_await Connect(socket, endpoint))
+  {
+    totals.failed.fetch_add(1, std::memory_order_relaxed);
+    co_return;
+  }
+  totals.connected.fetch_add(1, std::memory_order_relaxed);
+
+  std::array<char, 1 << 16> buffer;
+  boost::system::error_code ec;
+  while (!ec)
+  {
+    const std::size_t read = co_await socket.next_layer().async_read_some(
+      asio::buffer(buffer),
+      asio::redirect_error(use_awaitable, ec));
+    totals.bytes.fetch_add(read, std::memory_order_relaxed);
+  }
+}
+
+// Sends into the room without being in it
+class Sender final
+  : public ChatRoomParticipant
+{
+  void DeliverMessage(
+    [[maybe_unused]] const ChatRoomParticipantPtr &participant,
+    [[maybe_unused]] const ChatMessagePtr &message) override
+  {
+  }
+};
+
+// Until the server stops allocating, e.g. after the last session is gone
+void WaitForQuiet()
+{
+  u64 last = allocations;
+  for (u32 quiet = 0; quiet < 3;)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const u64 now = allocations;
+    quiet = now == last ? quiet + 1 : 0;
+    last = now;
+  }
+}
+
+void WaitForClients(const Totals &totals, u32 clients)
+{
+  const auto deadline = Clock::now() + std::chrono::seconds(30);
+  while (totals.connected + totals.failed < clients && Clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  WaitForQuiet();
+}
+
+// Thousands of sockets need more than the usual soft limit of descriptors
+void RaiseDescriptorLimit()
+{
+  rlimit limit {};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+struct Allocations
+{
+  u64 total = allocations;
+  u64 heap = RecyclingPool::heap_allocations.Value();
+  u64 recycled = RecyclingPool::recycled_allocations.Value();
+};
+
+void Print(
+  std::string_view name,
+  std::string_view per,
+  u64 count,
+  const Allocations &start)
+{
+  const Allocations end;
+  const auto ratio = [count](u64 from, u64 to) {
+    return static_cast<double>(to - from) / static_cast<double>(count);
+  };
+
+  fmt::print(
+    "{:<12} pool {:<3} {:>8.2f} allocations/{} {:>7.2f} pool heap"
+    " {:>7.2f} pool recycled\n",
+    name,
+    RECYCLING_POOL_BYTES == 0 ? "off" : "on",
+    ratio(start.total, end.total),
+    per,
+    ratio(start.heap, end.heap),
+    ratio(start.recycled, end.recycled));
+}
+
+void RunConnections(
+  asio::io_context &io,
+  tcp::endpoint endpoint,
+  u32 connections,
+  bool report)
+{
+  Totals totals;
+  const Allocations start;
+  for (u32 i = 0; i < connections; ++i)
+  {
+    co_spawn(asio::make_strand(io), Churn(totals, endpoint), detached);
+  }
+  WaitForClients(totals, connections);
+
+  if (report)
+  {
+    Print("connections", "connection", totals.connected, start);
+  }
+}
+
+void RunMessages(
+  ThreadSafeChatRoom &room,
+  Totals &totals,
+  u32 receivers,
+  u32 messages,
+  bool report)
+{
+  auto sender = std::make_shared<Sender>();
+  std::vector<ChatMessagePtr> batch;
+  for (u32 i = 0; i < messages; ++i)
+  {
+    batch.push_back(ChatMessage::Create(
+      {"bench", fmt::format("{:06} {}", i, std::string(200, 'x')), "bench"}));
+  }
+  // the numbers are padded, every frame has the same size
+  const u64 frame_bytes = u64 {receivers} * batch.back()->Frame().size();
+
+  const Allocations start;
+  for (const ChatMessagePtr &message : batch)
+  {
+    // one at a time, a burst would only measure how much the pool keeps
+    const u64 delivered = totals.bytes + frame_bytes;
+    room.DeliverMessage(sender, message);
+
+    const auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (totals.bytes < delivered && Clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+  WaitForQuiet();
+
+  if (report)
+  {
+    Print("messages", "delivery", u64 {messages} * receivers, start);
+  }
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  counted = false;
+
+  AccuireEnvs();
+
+  PORT = argc > 1 ? std::atoi(argv[1]) : 18080;
+  const u32 connections = argc > 2 ? std::atoi(argv[2]) : 2'000;
+  const u32 receivers = argc > 3 ? std::atoi(argv[3]) : 1'000;
+  const u32 messages = argc > 4 ? std::atoi(argv[4]) : 1'000;
+
+  RaiseDescriptorLimit();
+
+  // everything else as the environment says, like the bridge itself
+  IO_THREADS = std::max(2u, std::thread::hardware_concurrency()) / 2;
+  IO_CONTEXTS = 1;
+  SLOW_CONSUMER_POLICY = SlowConsumerPolicy::drop_newest;
+  WRITE_STALL_TIMEOUT_MS = 0;
+  DEFLATE_LEVEL = 0;
+
+  IoContextPool pool(IO_CONTEXTS, IO_THREADS);
+  auto room = std::make_shared<ThreadSafeChatRoom>(pool.GetContext(0));
+  Server server(pool, room);
+  std::thread server_thread([&pool] { pool.Run(); });
+
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::vector<std::thread> client_threads;
+  for (u32 i = 0; i < IO_THREADS; ++i)
+  {
+    client_threads.emplace_back([&io] {
+      counted = false;
+      io.run();
+    });
+  }
+
+  const tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), PORT);
+  constexpr std::array<u64, 2> settings {0, 1 << 20};
+
+  for (const u64 bytes : settings)
+  {
+    RECYCLING_POOL_BYTES = bytes;
+    RunConnections(io, endpoint, connections, false);
+    RunConnections(io, endpoint, connections, true);
+  }
+
+  Totals totals;
+  for (u32 i = 0; i < receivers; ++i)
+  {
+    co_spawn(asio::make_strand(io), Receiver(totals, endpoint), detached);
+  }
+  WaitForClients(totals, receivers);
+  fmt::print("{} of {} receivers connected\n", totals.connected, receivers);
+
+  for (const u64 bytes : settings)
+  {
+    RECYCLING_POOL_BYTES = bytes;
+    RunMessages(*room, totals, totals.connected, messages, false);
+    RunMessages(*room, totals, totals.connected, messages, true);
+  }
+
+  io.stop();
+  for (auto &thread : client_threads)
+  {
+    thread.join();
+  }
+
+  // the sessions never run out of work on their own
+  for (std::size_t i = 0; i < pool.Size(); ++i)
+  {
+    pool.GetContext(i).stop();
+  }
+  server_thread.join();
+
+  return 0;
+}
@@ -0,0 +1,217 @@
+#include "common/common.hpp"
+#include "common/ChatRoom.hpp"
+#include "common/IoContextPool.hpp"
+#include "common/Server.hpp"
+
+#include <sys/resource.h>
+
+// A Server and its ThreadSafeChatRoom on the loopback with receivers clients
+// that only count the bytes they read, so the CPU time is mostly the
+// bridge's. For every room size the room broadcasts the same number of
+// deliveries twice, once with every session framing the messages itself and
+// once with the frames the room encoded, and reports the throughput and the
+// CPU time of the process per delivered message.
+// usage: broadcast_bench [port] [deliveries per room size] [message bytes]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::tcp;
+using WebSocket = beast::websocket::stream<tcp::socket>;
+
+struct Totals
+{
+  std::atomic<u32> connected = 0;
+  std::atomic<u32> failed = 0;
+  std::atomic<u64> bytes = 0;
+};
+
+// Only the handshake goes through beast, the frames are counted as bytes
+awaitable<void> Client(Totals &totals, tcp::endpoint endpoint)
+{
+  WebSocket socket(co_await asio::this_coro::executor);
+
+  try
+  {
+    co_await socket.next_layer().async_connect(endpoint, use_awaitable);
+    co_await socket.async_handshake("127.0.0.1", "/", use_awaitable);
+  }
+  catch (std::exception&)
+  {
+    totals.failed.fetch_add(1, std::memory_order_relaxed);
+    co_return;
+  }
+  totals.connected.fetch_add(1, std::memory_order_relaxed);
+
+  std::array<char, 1 << 16> buffer;
+  boost::system::error_code ec;
+  while (!ec)
+  {
+    const std::size_t read = co_await socket.next_layer().async_read_some(
+      asio::buffer(buffer),
+      asio::redirect_error(use_awaitable, ec));
+    totals.bytes.fetch_add(read, std::memory_order_relaxed);
+  }
+}
+
+// Sends into the room without being in it
+class Sender final
+  : public ChatRoomParticipant
+{
+  void DeliverMessage(
+    [[maybe_unused]] const ChatRoomParticipantPtr &participant,
+    [[maybe_unused]] const ChatMessagePtr &message) override
+  {
+  }
+};
+
+auto CpuSeconds() -> double
+{
+  rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) *
+           1e-6;
+}
+
+// Thousands of sockets need more than the usual soft limit of descriptors
+void RaiseDescriptorLimit()
+{
+  rlimit limit {};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+void Run(
+  ThreadSafeChatRoom &room,
+  Totals &totals,
+  u32 receivers,
+  u64 messages,
+  u32 size,
+  bool preframed)
+{
+  PREFRAMED_BROADCAST = preframed;
+
+  auto sender = std::make_shared<Sender>();
+  std::vector<ChatMessagePtr> batch;
+  for (u64 i = 0; i < messages; ++i)
+  {
+    batch.push_back(ChatMessage::Create(
+      {"bench", fmt::format("{} {}", i, std::string(size, 'x')), "bench"}));
+  }
+
+  // every frame has the same size, headers included
+  const u64 expected =
+    totals.bytes + messages * receivers * batch.front()->Frame().size();
+
+  const double cpu_start = CpuSeconds();
+  const auto start = Clock::now();
+  for (const ChatMessagePtr &message : batch)
+  {
+    room.DeliverMessage(sender, message);
+  }
+
+  const auto deadline = start + std::chrono::seconds(60);
+  while (totals.bytes < expected && Clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+  const double cpu = CpuSeconds() - cpu_start;
+
+  const u64 deliveries = messages * receivers;
+  fmt::print(
+    "{:>6} receivers {:<12} {:>9.3f} ms {:>10.0f} deliveries/s"
+    " {:>8.1f} ns cpu/delivery{}\n",
+    receivers,
+    preframed ? "preframed" : "per session",
+    elapsed.count() * 1e3,
+    static_cast<double>(deliveries) / elapsed.count(),
+    cpu * 1e9 / static_cast<double>(deliveries),
+    totals.bytes < expected ? " (timed out)" : "");
+  totals.bytes = expected;
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  AccuireEnvs();
+
+  PORT = argc > 1 ? std::atoi(argv[1]) : 18080;
+  const u64 budget = argc > 2 ? std::atoll(argv[2]) : 2'000'000;
+  const u32 size = argc > 3 ? std::atoi(argv[3]) : 200;
+
+  RaiseDescriptorLimit();
+
+  // everything else as the environment says, like the bridge itself
+  IO_THREADS = std::max(2u, std::thread::hardware_concurrency()) / 2;
+  IO_CONTEXTS = 1;
+  // nothing is dropped, every run waits for all of its bytes
+  SESSION_QUEUE_MESSAGES = 1 << 20;
+  SESSION_QUEUE_BYTES = u64 {1} << 32;
+  SLOW_CONSUMER_POLICY = SlowConsumerPolicy::drop_newest;
+  WRITE_STALL_TIMEOUT_MS = 0;
+  DEFLATE_LEVEL = 0;
+
+  IoContextPool pool(IO_CONTEXTS, IO_THREADS);
+  auto room = std::make_shared<ThreadSafeChatRoom>(pool.GetContext(0));
+  Server server(pool, room);
+  std::thread server_thread([&pool] { pool.Run(); });
+
+  // the clients get the other half of the cores
+  asio::io_context io;
+  auto work = asio::make_work_guard(io);
+  std::vector<std::thread> client_threads;
+  for (u32 i = 0; i < IO_THREADS; ++i)
+  {
+    client_threads.emplace_back([&io] { io.run(); });
+  }
+
+  Totals totals;
+  const tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), PORT);
+  u32 clients = 0;
+  for (const u32 receivers : {1'000, 10'000})
+  {
+    for (; clients < receivers; ++clients)
+    {
+      co_spawn(asio::make_strand(io), Client(totals, endpoint), detached);
+    }
+
+    const auto connect_deadline = Clock::now() + std::chrono::seconds(30);
+    while (totals.connected + totals.failed < clients &&
+           Clock::now() < connect_deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    // the sessions join the room right after the handshake
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    const u32 connected = totals.connected;
+    fmt::print("{} of {} clients connected\n", connected, clients);
+
+    const u64 messages = std::max<u64>(1, budget / connected);
+    Run(*room, totals, connected, messages, size, false);
+    Run(*room, totals, connected, messages, size, true);
+  }
+
+  io.stop();
+  for (auto &thread : client_threads)
+  {
+    thread.join();
+  }
+
+  // the sessions never run out of work on their own
+  for (std::size_t i = 0; i < pool.Size(); ++i)
+  {
+    pool.GetContext(i).stop();
+  }
+  server_thread.join();
+
+  return 0;
+}
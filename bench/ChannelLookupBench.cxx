@@ -0,0 +1,128 @@
+#include "common/common.hpp"
+#include "bot/BotSettings.hpp"
+
+#include <random>
+
+#include <unistd.h>
+
+// Looks up the channels of clients the way BotChatSession::DeliverMessage
+// does for every message, once for bound clients and once for clients that
+// aren't bound anywhere, then again while another thread keeps binding and
+// unbinding, which publishes a new routing table every time. The bindings
+// are loaded from a snapshot file in a fresh temporary directory.
+// usage: channel_lookup_bench [clients] [channels per client] [lookups]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+
+template <typename Lookup>
+void Run(
+  std::string_view name,
+  const std::vector<std::string> &clients,
+  u64 lookups,
+  Lookup &&lookup)
+{
+  // keeps the compiler from throwing the work away
+  std::size_t checksum = 0;
+
+  const auto start = Clock::now();
+  for (u64 i = 0; i < lookups; ++i)
+  {
+    checksum += lookup(clients[i % clients.size()]);
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  fmt::print(
+    "{:<22} {:>9.3f} ms {:>8.1f} ns/lookup (checksum {})\n",
+    name,
+    elapsed.count() * 1e3,
+    elapsed.count() * 1e9 / static_cast<double>(lookups),
+    checksum);
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  AccuireEnvs();
+
+  const u32 client_count = argc > 1 ? std::atoi(argv[1]) : 10'000;
+  const u32 channels_per_client = argc > 2 ? std::atoi(argv[2]) : 2;
+  const u64 lookups = argc > 3 ? std::atoll(argv[3]) : 10'000'000;
+
+  // the settings read and write their files in the working directory
+  char directory[] = "/tmp/channel_lookup_bench.XXXXXX";
+  if (mkdtemp(directory) == nullptr || chdir(directory) != 0)
+  {
+    fmt::print("couldn't make a temporary directory\n");
+    return 1;
+  }
+
+  JOURNAL_COMPACT_RECORDS = 1 << 30;
+
+  // every bind publishes a new table, loading them all from the
+  // snapshot publishes once
+  std::mt19937_64 random(42);
+  std::vector<std::string> bound;
+  std::vector<std::string> unbound;
+  {
+    std::ofstream snapshot(BotSettings::client_to_channel_file_name);
+    snapshot << R"({"values":[)";
+    for (u32 i = 0; i < client_count; ++i)
+    {
+      bound.push_back(fmt::format("GameServer{:05}", i));
+      unbound.push_back(fmt::format("Unbound{:05}", i));
+
+      for (u32 j = 0; j < channels_per_client; ++j)
+      {
+        snapshot << fmt::format(
+          R"({}{{"client":"{}","channel":"{}"}})",
+          i == 0 && j == 0 ? "" : ",",
+          bound.back(),
+          random());
+      }
+    }
+    snapshot << "]}";
+  }
+
+  BotSettings settings;
+
+  // a shuffled order, so the lookups aren't all in cache by construction
+  std::ranges::shuffle(bound, random);
+
+  fmt::print(
+    "{} clients x {} channels, {} lookups ({})\n",
+    client_count,
+    channels_per_client,
+    lookups,
+    directory);
+
+  // the way BotChatSession::DeliverMessage does it, pinning the table
+  auto lookup = [&settings](const std::string &client) {
+    return settings.GetRoutes()->GetChannelList(client).size();
+  };
+
+  Run("  bound", bound, lookups, lookup);
+  Run("  unbound", unbound, lookups, lookup);
+
+  std::atomic<bool> stop = false;
+  u64 publishes = 0;
+  std::thread writer([&settings, &stop, &publishes] {
+    while (!stop.load(std::memory_order_relaxed))
+    {
+      settings.BindClient("Churn", 1);
+      settings.UnbindClient("Churn", 1);
+      publishes += 2;
+    }
+  });
+
+  Run("  bound, binding", bound, lookups, lookup);
+  stop = true;
+  writer.join();
+  fmt::print("  {} tables published meanwhile\n", publishes);
+
+  return 0;
+}
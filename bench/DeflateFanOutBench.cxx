@@ -0,0 +1,174 @@
+#include "common/common.hpp"
+#include "common/ChatMessage.hpp"
+#include "common/WebSocketFrame.hpp"
+
+#include "boost/beast/zlib/inflate_stream.hpp"
+
+#include <ctime>
+#include <random>
+
+// What a delivered message costs in bytes on the wire and in CPU to compress
+// at different fan-out sizes: uncompressed, deflated by every receiver on its
+// own like a per-stream permessage-deflate would, and deflated once per
+// message and shared the way ClientChatSession::Writer does it. Every room
+// size gets about the same number of deliveries, each message is fresh so
+// nothing is compressed ahead of time. One frame is inflated back first to
+// make sure it round trips.
+// usage: deflate_fanout_bench [deliveries per room size] [deflate level]
+
+namespace
+{
+
+using namespace bridge;
+
+constexpr u8 WINDOW_BITS = DEFLATE_MAX_WINDOW_BITS;
+
+// Made up chat lines out of a small vocabulary, the way chat repeats itself
+auto MakeMessages(u64 count, std::mt19937_64 &random)
+  -> std::vector<ChatMessagePtr>
+{
+  static constexpr std::array<std::string_view, 24> words {
+    "gg", "one", "more", "round", "anyone", "up", "for", "the", "next",
+    "map", "rush", "B", "site", "nice", "shot", "lag", "again", "server",
+    "restart", "in", "five", "minutes", "please", "team"};
+
+  std::vector<ChatMessagePtr> messages;
+  messages.reserve(count);
+  for (u64 i = 0; i < count; ++i)
+  {
+    std::string text;
+    const u64 length = 20 + random() % 40;
+    for (u64 word = 0; word < length; ++word)
+    {
+      text += words[random() % words.size()];
+      text += ' ';
+    }
+
+    messages.push_back(ChatMessage::Create({
+      fmt::format("Player{}", random() % 1000),
+      std::move(text),
+      fmt::format("GameServer{:02}", random() % 16)}));
+    // rendered up front, only the compression is measured
+    static_cast<void>(messages.back()->Json());
+  }
+
+  return messages;
+}
+
+auto CpuSeconds() -> double
+{
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+auto FrameSize(std::size_t payload_size) -> std::size_t
+{
+  return FrameHeader(FrameOpcode::text, payload_size).Buffer().size() +
+         payload_size;
+}
+
+// Inflates a deflated payload back, with the tail the sender left out
+auto Inflate(const std::string &deflated) -> std::string
+{
+  std::string input = deflated;
+  input.append("\x00\x00\xff\xff", 4);
+
+  beast::zlib::inflate_stream stream;
+  stream.reset(WINDOW_BITS);
+
+  std::string out(1 << 16, '\0');
+  beast::zlib::z_params params;
+  params.next_in = input.data();
+  params.avail_in = input.size();
+  params.next_out = out.data();
+  params.avail_out = out.size();
+
+  boost::system::error_code ec;
+  stream.write(params, beast::zlib::Flush::sync, ec);
+  out.resize(params.total_out);
+  return out;
+}
+
+void Print(
+  u32 receivers,
+  std::string_view name,
+  u64 deliveries,
+  u64 bytes,
+  double cpu)
+{
+  fmt::print(
+    "{:>6} receivers {:<12} {:>8.1f} B/delivery {:>9.1f} ns cpu/delivery\n",
+    receivers,
+    name,
+    static_cast<double>(bytes) / static_cast<double>(deliveries),
+    cpu * 1e9 / static_cast<double>(deliveries));
+}
+
+void Run(u32 receivers, u64 messages, std::mt19937_64 &random)
+{
+  const u64 deliveries = messages * receivers;
+
+  // per receiver doesn't fill the messages' cache, shared starts out cold
+  const auto plain = MakeMessages(messages, random);
+  u64 bytes = 0;
+  for (const ChatMessagePtr &message : plain)
+  {
+    bytes += FrameSize(message->Size()) * receivers;
+  }
+  Print(receivers, "plain", deliveries, bytes, 0);
+
+  bytes = 0;
+  double start = CpuSeconds();
+  for (const ChatMessagePtr &message : plain)
+  {
+    for (u32 i = 0; i < receivers; ++i)
+    {
+      const auto deflated = FrameDeflate::Deflate(message->Json(), WINDOW_BITS);
+      bytes += FrameSize(deflated.empty() ? message->Size() : deflated.size());
+    }
+  }
+  Print(receivers, "per receiver", deliveries, bytes, CpuSeconds() - start);
+
+  bytes = 0;
+  start = CpuSeconds();
+  for (const ChatMessagePtr &message : plain)
+  {
+    for (u32 i = 0; i < receivers; ++i)
+    {
+      const std::string &frame = message->DeflatedFrame(WINDOW_BITS);
+      bytes += frame.empty() ? FrameSize(message->Size()) : frame.size();
+    }
+  }
+  Print(receivers, "shared", deliveries, bytes, CpuSeconds() - start);
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  AccuireEnvs();
+
+  const u64 budget = argc > 1 ? std::atoll(argv[1]) : 200'000;
+  DEFLATE_LEVEL = argc > 2 ? std::atoi(argv[2]) : 1;
+
+  std::mt19937_64 random(42);
+
+  const auto check = MakeMessages(1, random).front();
+  const std::string deflated = FrameDeflate::Deflate(check->Json(), WINDOW_BITS);
+  if (deflated.empty() || Inflate(deflated) != check->Json() ||
+      !check->DeflatedFrame(WINDOW_BITS).ends_with(deflated))
+  {
+    fmt::print("deflated frame doesn't round trip\n");
+    return 1;
+  }
+
+  fmt::print("deflate level {}, window bits {}\n", DEFLATE_LEVEL, WINDOW_BITS);
+  for (const u32 receivers : {1, 10, 100, 1'000})
+  {
+    // about the same number of deliveries for every room size
+    const u64 messages = std::max<u64>(1, budget / receivers);
+
+    Run(receivers, messages, random);
+  }
+
+  return 0;
+}
@@ -0,0 +1,142 @@
+#include "common/common.hpp"
+#include "common/ChatRoom.hpp"
+#include "common/Metrics.hpp"
+#include "bot/Bot.hpp"
+#include "bot/FakeDiscordGateway.hpp"
+
+#include <future>
+
+#include <unistd.h>
+
+// Both directions of the Discord side through a BotChatSession on the fake
+// gateway, no token or network needed. Inbound the fake injects message
+// events at a fixed rate and a participant in the room takes the time they
+// arrive. Outbound a client bound through /bindclient sends into the room at
+// a fixed rate and the fake records the sends, answering them after the
+// simulated REST latency and with 429s past Discord's 5 per 5 seconds.
+// usage: discord_path_bench [events/s] [sends/s] [seconds] [rest latency ms]
+//                           [coalesce ms]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+
+constexpr u64 CHANNEL = 100;
+
+class TimingParticipant final
+  : public ChatRoomParticipant
+{
+public:
+  Histogram latency {
+    "bridge_bench_discord_inbound_seconds",
+    "From a Discord event to a room participant",
+    1'000,
+    30'000'000'000,
+    1e-9};
+
+private:
+  void DeliverMessage(
+    [[maybe_unused]] const ChatRoomParticipantPtr &participant,
+    const ChatMessagePtr &message) override
+  {
+    latency.RecordSince(message->Created());
+  }
+};
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  AccuireEnvs();
+
+  const double event_rate = argc > 1 ? std::atof(argv[1]) : 1000;
+  const double send_rate = argc > 2 ? std::atof(argv[2]) : 10;
+  const u32 seconds = argc > 3 ? std::atoi(argv[3]) : 5;
+  const u32 rest_latency_ms = argc > 4 ? std::atoi(argv[4]) : 50;
+  DISCORD_COALESCE_MS = argc > 5 ? std::atoi(argv[5]) : 250;
+
+  // the bindings are read and written in the working directory
+  char directory[] = "/tmp/discord_path_bench.XXXXXX";
+  if (mkdtemp(directory) == nullptr || chdir(directory) != 0)
+  {
+    fmt::print("couldn't make a temporary directory\n");
+    return 1;
+  }
+
+  asio::io_context io;
+  auto room = std::make_shared<ThreadSafeChatRoom>(io);
+
+  auto gateway = std::make_unique<FakeDiscordGateway>(FakeDiscordOptions {
+    .message_rate = event_rate,
+    .channels = {CHANNEL},
+    .rest_latency = std::chrono::milliseconds(rest_latency_ms)});
+  FakeDiscordGateway &fake = *gateway;
+
+  auto bot = std::make_shared<BotChatSession>(room, std::move(gateway), io);
+  auto timing = std::make_shared<TimingParticipant>();
+  room->Join(timing);
+  // only what came from Discord, not the outbound messages
+  room->Subscribe(timing, "Discord");
+
+  std::thread worker([&io] {
+    auto work = asio::make_work_guard(io);
+    io.run();
+  });
+
+  bot->Start();
+
+  std::promise<std::string> bound;
+  fake.InjectCommand(
+    CHANNEL,
+    "bindclient",
+    {{"client", "bench"}},
+    [&bound](const std::string &reply) { bound.set_value(reply); });
+  fmt::print("/bindclient: {}\n", bound.get_future().get());
+
+  // the outbound side, as a client in the room bound to CHANNEL
+  const auto interval = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(1 / std::max(send_rate, 0.001)));
+
+  const auto start = Clock::now();
+  u64 sent = 0;
+  for (auto next = start; next < start + std::chrono::seconds(seconds);
+       next += interval)
+  {
+    std::this_thread::sleep_until(next);
+    room->DeliverMessage(
+      timing,
+      ChatMessage::Create({"bench", fmt::format("{}", sent), "bench"}));
+    ++sent;
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  // the last REST calls still have to come back
+  std::this_thread::sleep_for(
+    std::chrono::milliseconds(DISCORD_COALESCE_MS + rest_latency_ms + 100));
+
+  const auto recorded = fake.SentMessages();
+  const u64 limited = fake.RateLimited();
+  fmt::print(
+    "inbound: {} events injected at {}/s, {} reached the room\n"
+    "  latency p50 {:.3f} ms p99 {:.3f} ms p999 {:.3f} ms\n"
+    "outbound: {} messages at {}/s in {:.2f} s, {} sends, {} rate limited\n",
+    fake.Injected(),
+    event_rate,
+    timing->latency.Count(),
+    timing->latency.Quantile(0.5) * 1e3,
+    timing->latency.Quantile(0.99) * 1e3,
+    timing->latency.Quantile(0.999) * 1e3,
+    sent,
+    send_rate,
+    elapsed.count(),
+    recorded.size(),
+    limited);
+
+  fake.Stop();
+  io.stop();
+  worker.join();
+
+  return 0;
+}
@@ -0,0 +1,209 @@
+#include "common/common.hpp"
+#include "common/ChatMessage.hpp"
+#include "common/MpscQueue.hpp"
+
+using boost::asio::co_spawn;
+using boost::asio::detached;
+using boost::asio::use_awaitable;
+using boost::asio::awaitable;
+
+// Compares ThreadSafeChatRoom's ingress before and after the lock free queue:
+// producer threads push shared messages, a single consumer coroutine drains
+// them on a strand the same way Delivery() does.
+// usage: ingress_queue_bench [producers] [messages per producer]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+  double seconds;
+  u64 wakeups;
+};
+
+// The old path, mutex + deque, a post per message, the consumer copies
+class MutexDequeIngress
+{
+  std::deque<ChatMessagePtr> messages_;
+  boost::mutex mutex_;
+  asio::steady_timer timer_;
+
+public:
+  u64 consumed = 0;
+  u64 wakeups = 0;
+
+  explicit MutexDequeIngress(asio::io_context &io)
+    : timer_(asio::make_strand(io))
+  {
+    timer_.expires_at(Clock::time_point::max());
+  }
+
+  void Push(const ChatMessagePtr &message)
+  {
+    {
+      boost::mutex::scoped_lock scoped_lock(mutex_);
+      messages_.push_back(message);
+    }
+
+    asio::post(timer_.get_executor(), [this] { timer_.cancel_one(); });
+  }
+
+  awaitable<void> Consume(u64 expected)
+  {
+    while (consumed < expected)
+    {
+      std::deque<ChatMessagePtr> copied;
+      {
+        boost::mutex::scoped_lock scoped_lock(mutex_);
+        copied = messages_;
+        messages_.clear();
+      }
+      consumed += copied.size();
+
+      if (consumed < expected)
+      {
+        boost::system::error_code ec;
+        co_await timer_.async_wait(asio::redirect_error(use_awaitable, ec));
+        ++wakeups;
+      }
+    }
+  }
+
+  auto Executor() { return timer_.get_executor(); }
+};
+
+// The new path, bounded MPSC queue + coalesced doorbell
+class MpscIngress
+{
+  BoundedMpscQueue<ChatMessagePtr> messages_;
+  std::atomic<bool> doorbell_rung_ = false;
+  asio::steady_timer timer_;
+
+public:
+  u64 consumed = 0;
+  u64 wakeups = 0;
+
+  MpscIngress(asio::io_context &io, std::size_t capacity)
+    : messages_(capacity),
+      timer_(asio::make_strand(io))
+  {
+    timer_.expires_at(Clock::time_point::max());
+  }
+
+  void Push(ChatMessagePtr message)
+  {
+    // the room drops here, the benchmark wants every message through
+    while (!messages_.TryPush(std::move(message)))
+    {
+      std::this_thread::yield();
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!doorbell_rung_.exchange(true, std::memory_order_relaxed))
+    {
+      asio::post(timer_.get_executor(), [this] { timer_.cancel_one(); });
+    }
+  }
+
+  awaitable<void> Consume(u64 expected)
+  {
+    ChatMessagePtr message;
+    while (consumed < expected)
+    {
+      doorbell_rung_.store(false, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      while (messages_.TryPop(message))
+      {
+        ++consumed;
+      }
+
+      if (consumed < expected)
+      {
+        boost::system::error_code ec;
+        co_await timer_.async_wait(asio::redirect_error(use_awaitable, ec));
+        ++wakeups;
+      }
+    }
+  }
+
+  auto Executor() { return timer_.get_executor(); }
+};
+
+template <typename Ingress>
+auto Run(
+  Ingress &ingress,
+  asio::io_context &io,
+  u32 producers,
+  u64 per_producer) -> Result
+{
+  const auto message =
+    ChatMessage::Create({"bench", std::string(64, 'x'), "bench"});
+  const u64 expected = producers * per_producer;
+
+  co_spawn(ingress.Executor(), ingress.Consume(expected), detached);
+  std::thread consumer([&io] { io.run(); });
+
+  const auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (u32 i = 0; i < producers; ++i)
+  {
+    threads.emplace_back([&ingress, &message, per_producer] {
+      for (u64 j = 0; j < per_producer; ++j)
+      {
+        ingress.Push(message);
+      }
+    });
+  }
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+  consumer.join();
+
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+  return {elapsed.count(), ingress.wakeups};
+}
+
+void Report(std::string_view name, const Result &result, u64 messages)
+{
+  fmt::print(
+    "{:<14} {:>9.3f} ms {:>12.0f} msg/s {:>10} wakeups\n",
+    name,
+    result.seconds * 1e3,
+    static_cast<double>(messages) / result.seconds,
+    result.wakeups);
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  const u32 producers = argc > 1
+    ? std::atoi(argv[1])
+    : std::max(2u, std::thread::hardware_concurrency());
+  const u64 per_producer = argc > 2 ? std::atoll(argv[2]) : 1'000'000;
+  const u64 messages = producers * per_producer;
+
+  fmt::print("{} producers x {} messages\n", producers, per_producer);
+
+  {
+    asio::io_context io(1);
+    MutexDequeIngress ingress(io);
+    const auto result = Run(ingress, io, producers, per_producer);
+    Report("mutex+deque", result, messages);
+  }
+
+  {
+    asio::io_context io(1);
+    MpscIngress ingress(io, 65536);
+    const auto result = Run(ingress, io, producers, per_producer);
+    Report("mpsc+doorbell", result, messages);
+  }
+
+  return 0;
+}
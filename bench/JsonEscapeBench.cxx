@@ -0,0 +1,150 @@
+#include "common/common.hpp"
+#include "common/MessageFormat.hpp"
+
+// Compares ways of rendering the envelope: the old unescaped fmt::format, a
+// byte at a time escaper into a fresh string, and ConstructJson with and
+// without a reused buffer. Every escaped rendering is parsed back first to
+// make sure it round trips.
+// usage: json_escape_bench [iterations]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+using Message = MessageFormatter::Message;
+
+// The old path, invalid json as soon as there's a quote in the message
+auto FormatUnescaped(const Message &msg) -> std::size_t
+{
+  return fmt::format(
+    "{{\"author\": \"{}\", \"message\": \"{}\", \"client\": \"{}\"}}",
+    msg.author, msg.message, msg.client).size();
+}
+
+void EscapeScalar(std::string &out, std::string_view value)
+{
+  for (const char c : value)
+  {
+    switch (c)
+    {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\b': out += "\\b"; break;
+    case '\f': out += "\\f"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+      {
+        out += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+        break;
+      }
+      out += c;
+    }
+  }
+}
+
+auto ConstructScalar(const Message &msg) -> std::size_t
+{
+  std::string out = "{\"author\": \"";
+  EscapeScalar(out, msg.author);
+  out += "\", \"message\": \"";
+  EscapeScalar(out, msg.message);
+  out += "\", \"client\": \"";
+  EscapeScalar(out, msg.client);
+  out += "\"}";
+  return out.size();
+}
+
+auto ConstructToString(const Message &msg) -> std::size_t
+{
+  return MessageFormatter::ConstructJson(msg).size();
+}
+
+auto ConstructReused(const Message &msg) -> std::size_t
+{
+  static fmt::memory_buffer buffer;
+
+  MessageFormatter::ConstructJson(msg, buffer);
+  return buffer.size();
+}
+
+auto RoundTrips(const Message &msg) -> bool
+{
+  const std::string json = MessageFormatter::ConstructJson(msg);
+  MessageParser parser(json);
+
+  return parser.IsValid() &&
+         parser.GetAuthor().value() == msg.author &&
+         parser.GetContent().value() == msg.message &&
+         parser.GetClient().value() == msg.client;
+}
+
+template <typename Construct>
+void Run(
+  std::string_view name,
+  const Message &msg,
+  u64 iterations,
+  Construct &&construct)
+{
+  // keeps the compiler from throwing the work away
+  std::size_t bytes = 0;
+
+  const auto start = Clock::now();
+  for (u64 i = 0; i < iterations; ++i)
+  {
+    bytes += construct(msg);
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  const double input = static_cast<double>(
+    (msg.author.size() + msg.message.size() + msg.client.size()) *
+    iterations);
+  fmt::print(
+    "{:<22} {:>9.3f} ms {:>10.1f} MB/s {:>12.0f} msg/s ({} bytes out)\n",
+    name,
+    elapsed.count() * 1e3,
+    input / elapsed.count() / 1e6,
+    static_cast<double>(iterations) / elapsed.count(),
+    bytes / iterations);
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  const u64 iterations = argc > 1 ? std::atoll(argv[1]) : 1'000'000;
+
+  // every byte has to be escaped
+  std::string worst;
+  for (u32 i = 0; i < 512; ++i)
+  {
+    worst += "\"\\\n\x01"[i % 4];
+  }
+
+  const std::array<std::pair<std::string_view, Message>, 4> messages {{
+    {"typical", {"SomeoneOnDiscord", "gg, one more round?", "GameServer01"}},
+    {"quoted", {"Someone", "he said \"no\" and left\nlol", "GameServer01"}},
+    {"long", {"Someone", std::string(4000, 'x'), "GameServer01"}},
+    {"worst case", {"Someone", worst, "GameServer01"}},
+  }};
+
+  for (const auto &[name, msg] : messages)
+  {
+    fmt::print(
+      "{}: {} bytes x {}, round trips: {}\n",
+      name,
+      msg.author.size() + msg.message.size() + msg.client.size(),
+      iterations,
+      RoundTrips(msg));
+
+    Run("  fmt (unescaped)", msg, iterations, FormatUnescaped);
+    Run("  scalar escape", msg, iterations, ConstructScalar);
+    Run("  simd, to string", msg, iterations, ConstructToString);
+    Run("  simd, reused buffer", msg, iterations, ConstructReused);
+  }
+
+  return 0;
+}
@@ -0,0 +1,377 @@
+#include "common/common.hpp"
+#include "common/MessageFormat.hpp"
+#include "common/Metrics.hpp"
+
+#include <charconv>
+
+#include <sys/resource.h>
+
+using boost::asio::co_spawn;
+using boost::asio::detached;
+using boost::asio::use_awaitable;
+using boost::asio::awaitable;
+
+// Opens clients loopback websocket connections to a running server, the
+// first senders of them send rate messages a second each for the given
+// seconds. Every message carries the time it was sent, every client takes
+// the time it arrived, which gives the delivery latency through the bridge.
+// Reports how fast the connections were set up, then the throughput and the
+// latency percentiles once the stragglers had a second to arrive. Given the
+// pid of a server on the same box, also what its read and write syscalls and
+// context switches cost per delivered message, io_uring_enter isn't counted
+// in those, its submissions are.
+// usage: bridge_loadgen [host] [port] [clients] [senders] [rate] [seconds]
+//                       [message bytes] [server pid]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::tcp;
+using WebSocket = beast::websocket::stream<tcp::socket>;
+
+struct Options
+{
+  std::string host;
+  std::string port;
+  u32 clients;
+  u32 senders;
+  // messages a second per sender
+  double rate;
+  u32 seconds;
+  u32 size;
+};
+
+struct Totals
+{
+  std::atomic<u32> connected = 0;
+  std::atomic<u32> failed = 0;
+  std::atomic<u64> sent = 0;
+  std::atomic<u64> received = 0;
+  std::atomic<u64> foreign = 0;
+  std::atomic<bool> sending = false;
+  std::atomic<bool> stopping = false;
+
+  Histogram latency {
+    "bridge_loadgen_delivery_seconds",
+    "From a loadgen client sending a message to another one reading it",
+    1'000,
+    30'000'000'000,
+    1e-9};
+};
+
+// The send time is the first word of the message
+auto SentAt(std::string_view text) -> std::optional<Clock::time_point>
+{
+  i64 nanoseconds = 0;
+  const auto [end, ec] =
+    std::from_chars(text.data(), text.data() + text.size(), nanoseconds);
+  if (ec != std::errc())
+  {
+    return std::nullopt;
+  }
+
+  return Clock::time_point(std::chrono::nanoseconds(nanoseconds));
+}
+
+awaitable<void> Sender(
+  std::shared_ptr<WebSocket> socket,
+  Totals &totals,
+  const Options &options,
+  u32 index)
+{
+  asio::steady_timer timer(socket->get_executor());
+  const auto interval = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(1 / options.rate));
+  const std::string padding(options.size, 'x');
+
+  // spread over the interval, so the senders don't all go at once
+  auto next = Clock::now() + interval * index / std::max(1u, options.senders);
+
+  try
+  {
+    while (!totals.stopping.load(std::memory_order_relaxed))
+    {
+      // open loop, a sender that fell behind catches up right away
+      next += interval;
+      timer.expires_at(next);
+      co_await timer.async_wait(use_awaitable);
+
+      if (!totals.sending.load(std::memory_order_relaxed))
+      {
+        continue;
+      }
+
+      const std::string json = MessageFormatter::ConstructJson({
+        "loadgen",
+        fmt::format(
+          "{} {}",
+          Clock::now().time_since_epoch().count(),
+          padding),
+        "loadgen"});
+
+      co_await socket->async_write(asio::buffer(json), use_awaitable);
+      totals.sent.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  catch (std::exception &e)
+  {
+    if (!totals.stopping.load(std::memory_order_relaxed))
+    {
+      fmt::print("sender {}: {}\n", index, e.what());
+    }
+  }
+}
+
+awaitable<void> Client(
+  Totals &totals,
+  const Options &options,
+  tcp::endpoint endpoint,
+  u32 index)
+{
+  auto socket = std::make_shared<WebSocket>(
+    co_await asio::this_coro::executor);
+
+  try
+  {
+    co_await socket->next_layer().async_connect(endpoint, use_awaitable);
+    socket->next_layer().set_option(tcp::no_delay(true));
+    co_await socket->async_handshake(options.host, "/", use_awaitable);
+  }
+  catch (std::exception&)
+  {
+    totals.failed.fetch_add(1, std::memory_order_relaxed);
+    co_return;
+  }
+  totals.connected.fetch_add(1, std::memory_order_relaxed);
+
+  if (index < options.senders)
+  {
+    co_spawn(
+      socket->get_executor(),
+      Sender(socket, totals, options, index),
+      detached);
+  }
+
+  beast::flat_buffer buffer;
+  try
+  {
+    while (!totals.stopping.load(std::memory_order_relaxed))
+    {
+      co_await socket->async_read(buffer, use_awaitable);
+      const auto now = Clock::now();
+
+      const std::string content = beast::buffers_to_string(buffer.data());
+      buffer.clear();
+
+      MessageParser parser(content);
+      auto text = parser.GetContent();
+      auto sent_at = text.has_value()
+        ? SentAt(text.value())
+        : std::nullopt;
+      if (!sent_at.has_value())
+      {
+        totals.foreign.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      totals.latency.RecordSince(*sent_at, now);
+      totals.received.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  catch (std::exception &e)
+  {
+    if (!totals.stopping.load(std::memory_order_relaxed))
+    {
+      fmt::print("client {}: {}\n", index, e.what());
+    }
+  }
+}
+
+// What the kernel counted for a process so far
+struct ProcessCounters
+{
+  u64 read_syscalls = 0;
+  u64 write_syscalls = 0;
+  u64 context_switches = 0;
+};
+
+// Reads "name: value" lines out of a /proc file into the matching counters
+void ReadProcFile(
+  const std::string &path,
+  std::initializer_list<std::pair<std::string_view, u64*>> fields)
+{
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    for (const auto &[name, value] : fields)
+    {
+      if (line.starts_with(name) && line.size() > name.size() &&
+          line[name.size()] == ':')
+      {
+        *value += std::strtoull(line.c_str() + name.size() + 1, nullptr, 10);
+      }
+    }
+  }
+}
+
+auto ReadProcessCounters(u32 pid) -> ProcessCounters
+{
+  ProcessCounters counters;
+  ReadProcFile(
+    fmt::format("/proc/{}/io", pid),
+    {{"syscr", &counters.read_syscalls},
+     {"syscw", &counters.write_syscalls}});
+  ReadProcFile(
+    fmt::format("/proc/{}/status", pid),
+    {{"voluntary_ctxt_switches", &counters.context_switches},
+     {"nonvoluntary_ctxt_switches", &counters.context_switches}});
+  return counters;
+}
+
+// Thousands of sockets need more than the usual soft limit of descriptors
+void RaiseDescriptorLimit()
+{
+  rlimit limit {};
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  Options options {
+    .host = argc > 1 ? argv[1] : "127.0.0.1",
+    .port = argc > 2 ? argv[2] : "8080",
+    .clients = argc > 3 ? static_cast<u32>(std::atoi(argv[3])) : 1000,
+    .senders = argc > 4 ? static_cast<u32>(std::atoi(argv[4])) : 10,
+    .rate = argc > 5 ? std::atof(argv[5]) : 100,
+    .seconds = argc > 6 ? static_cast<u32>(std::atoi(argv[6])) : 10,
+    .size = argc > 7 ? static_cast<u32>(std::atoi(argv[7])) : 64};
+  const u32 server_pid = argc > 8 ? static_cast<u32>(std::atoi(argv[8])) : 0;
+
+  options.senders = std::min(options.senders, options.clients);
+  options.rate = std::max(options.rate, 0.001);
+
+  RaiseDescriptorLimit();
+
+  asio::io_context io;
+  const tcp::endpoint endpoint =
+    *tcp::resolver(io).resolve(options.host, options.port).begin();
+
+  Totals totals;
+  const auto connect_start = Clock::now();
+  for (u32 i = 0; i < options.clients; ++i)
+  {
+    co_spawn(
+      asio::make_strand(io),
+      Client(totals, options, endpoint, i),
+      detached);
+  }
+
+  auto work = asio::make_work_guard(io);
+  std::vector<std::thread> threads;
+  for (u32 i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+  {
+    threads.emplace_back([&io] { io.run(); });
+  }
+
+  const auto connect_deadline = Clock::now() + std::chrono::seconds(30);
+  while (totals.connected + totals.failed < options.clients &&
+         Clock::now() < connect_deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  const std::chrono::duration<double> connect_elapsed =
+    Clock::now() - connect_start;
+
+  const u32 connected = totals.connected;
+  fmt::print(
+    "{} of {} clients connected to {}:{}, {} failed, in {:.3f} s"
+    " ({:.0f} handshakes/s)\n",
+    connected,
+    options.clients,
+    options.host,
+    options.port,
+    totals.failed.load(),
+    connect_elapsed.count(),
+    static_cast<double>(connected) / connect_elapsed.count());
+  fmt::print(
+    "{} senders x {} msg/s x {} s, {} bytes of padding\n",
+    options.senders,
+    options.rate,
+    options.seconds,
+    options.size);
+
+  const ProcessCounters server_before = server_pid != 0
+    ? ReadProcessCounters(server_pid)
+    : ProcessCounters {};
+
+  const auto start = Clock::now();
+  totals.sending = true;
+  std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+  totals.sending = false;
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  // the stragglers still count, whatever isn't there after this is lost
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  totals.stopping = true;
+
+  const ProcessCounters server_after = server_pid != 0
+    ? ReadProcessCounters(server_pid)
+    : ProcessCounters {};
+
+  const u64 sent = totals.sent;
+  const u64 received = totals.received;
+  // nobody gets their own messages back
+  const u64 expected = sent * (connected == 0 ? 0 : connected - 1);
+
+  fmt::print(
+    "sent {:>12} {:>12.0f} msg/s\n"
+    "received {:>8} {:>12.0f} msg/s, {} expected, {} foreign\n"
+    "latency p50 {:.3f} ms p99 {:.3f} ms p999 {:.3f} ms max {:.3f} ms\n",
+    sent,
+    static_cast<double>(sent) / elapsed.count(),
+    received,
+    static_cast<double>(received) / elapsed.count(),
+    expected,
+    totals.foreign.load(),
+    totals.latency.Quantile(0.5) * 1e3,
+    totals.latency.Quantile(0.99) * 1e3,
+    totals.latency.Quantile(0.999) * 1e3,
+    totals.latency.Quantile(1) * 1e3);
+
+  if (server_pid != 0)
+  {
+    const double per_message =
+      1 / static_cast<double>(std::max<u64>(1, sent + received));
+    fmt::print(
+      "server {}: {:.3f} read syscalls {:.3f} write syscalls"
+      " {:.3f} context switches per message in or out\n",
+      server_pid,
+      static_cast<double>(
+        server_after.read_syscalls - server_before.read_syscalls) *
+        per_message,
+      static_cast<double>(
+        server_after.write_syscalls - server_before.write_syscalls) *
+        per_message,
+      static_cast<double>(
+        server_after.context_switches - server_before.context_switches) *
+        per_message);
+  }
+
+  io.stop();
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include "common/common.hpp"
+#include "common/MessageFormat.hpp"
+
+// Compares the old property_tree path of MessageParser with the single pass
+// parser on the envelope, once with a typical chat message and once with a
+// message that's mostly escapes.
+// usage: message_parser_bench [iterations]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+
+// The old path, a full ptree through an istringstream, a copy per field
+auto ParsePtree(const std::string &message) -> std::size_t
+{
+  ptree tree;
+  auto stream = std::istringstream(message);
+  boost::property_tree::json_parser::read_json(stream, tree);
+
+  return tree.get<std::string>("author").size() +
+         tree.get<std::string>("message").size() +
+         tree.get<std::string>("client").size();
+}
+
+auto ParseSinglePass(const std::string &message) -> std::size_t
+{
+  MessageParser parser(message);
+
+  return parser.GetAuthor().value().size() +
+         parser.GetContent().value().size() +
+         parser.GetClient().value().size();
+}
+
+auto Envelope(std::string_view content) -> std::string
+{
+  return fmt::format(
+    "{{\"author\": \"SomeoneOnDiscord\", \"message\": \"{}\", "
+    "\"client\": \"GameServer01\"}}",
+    content);
+}
+
+template <typename Parse>
+void Run(
+  std::string_view name,
+  const std::string &message,
+  u64 iterations,
+  Parse &&parse)
+{
+  // keeps the compiler from throwing the work away
+  std::size_t checksum = 0;
+
+  const auto start = Clock::now();
+  for (u64 i = 0; i < iterations; ++i)
+  {
+    checksum += parse(message);
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  const double bytes = static_cast<double>(message.size() * iterations);
+  fmt::print(
+    "{:<22} {:>9.3f} ms {:>10.1f} MB/s {:>12.0f} msg/s (checksum {})\n",
+    name,
+    elapsed.count() * 1e3,
+    bytes / elapsed.count() / 1e6,
+    static_cast<double>(iterations) / elapsed.count(),
+    checksum);
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  const u64 iterations = argc > 1 ? std::atoll(argv[1]) : 200'000;
+
+  std::string escaped;
+  for (u32 i = 0; i < 64; ++i)
+  {
+    escaped += R"(\"quoted\" \\path\\ line\n\u00e9 )";
+  }
+
+  const std::array<std::pair<std::string_view, std::string>, 3> messages {{
+    {"typical", Envelope("hey, anyone up for another round on de_dust2?")},
+    {"long", Envelope(std::string(4000, 'x'))},
+    {"escapes", Envelope(escaped)},
+  }};
+
+  for (const auto &[name, message] : messages)
+  {
+    fmt::print("{}: {} bytes x {}\n", name, message.size(), iterations);
+    Run("  ptree", message, iterations, ParsePtree);
+    Run("  single pass", message, iterations, ParseSinglePass);
+  }
+
+  return 0;
+}
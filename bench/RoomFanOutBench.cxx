@@ -0,0 +1,95 @@
+#include "common/common.hpp"
+#include "common/ChatRoom.hpp"
+
+// ChatRoom::DeliverMessage on its own, without sockets or strands: every
+// receiver only counts what it gets. Once with every participant unfiltered
+// and once with all of them subscribed to other topics except one in a
+// hundred, which is the case the topic index is there for.
+// usage: room_fanout_bench [deliveries per room size]
+
+namespace
+{
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+
+class CountingParticipant final
+  : public ChatRoomParticipant
+{
+public:
+  u64 received = 0;
+
+private:
+  void DeliverMessage(
+    [[maybe_unused]] const ChatRoomParticipantPtr &participant,
+    [[maybe_unused]] const ChatMessagePtr &message) override
+  {
+    ++received;
+  }
+};
+
+void Run(u32 receivers, u64 messages, bool filtered)
+{
+  ChatRoom room;
+  std::vector<std::shared_ptr<CountingParticipant>> participants;
+
+  auto sender = std::make_shared<CountingParticipant>();
+  room.Join(sender);
+
+  for (u32 i = 0; i < receivers; ++i)
+  {
+    participants.push_back(std::make_shared<CountingParticipant>());
+    room.Join(participants.back());
+
+    if (filtered)
+    {
+      room.Subscribe(
+        participants.back(),
+        i % 100 == 0 ? "GameServer01" : fmt::format("Other{}", i % 16));
+    }
+  }
+
+  const auto message = ChatMessage::Create(
+    {"SomeoneOnDiscord", "gg, one more round?", "GameServer01"});
+
+  const auto start = Clock::now();
+  for (u64 i = 0; i < messages; ++i)
+  {
+    room.DeliverMessage(sender, message);
+  }
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  u64 delivered = 0;
+  for (const auto &participant : participants)
+  {
+    delivered += participant->received;
+  }
+
+  fmt::print(
+    "{:>6} receivers {:<10} {:>9.3f} ms {:>10.1f} ns/msg {:>7.2f} ns/delivery"
+    " ({} delivered)\n",
+    receivers,
+    filtered ? "filtered" : "unfiltered",
+    elapsed.count() * 1e3,
+    elapsed.count() * 1e9 / static_cast<double>(messages),
+    elapsed.count() * 1e9 / static_cast<double>(std::max<u64>(1, delivered)),
+    delivered);
+}
+
+} // namespace
+
+auto main(i32 argc, char **argv) -> i32
+{
+  const u64 budget = argc > 1 ? std::atoll(argv[1]) : 10'000'000;
+
+  for (const u32 receivers : {1, 10, 100, 1'000, 10'000})
+  {
+    // about the same number of deliveries for every room size
+    const u64 messages = std::max<u64>(1, budget / receivers);
+
+    Run(receivers, messages, false);
+    Run(receivers, messages, true);
+  }
+
+  return 0;
+}
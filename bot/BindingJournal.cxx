@@ -0,0 +1,309 @@
+#include "BindingJournal.hpp"
+
+#include <charconv>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace bridge;
+
+namespace
+{
+
+auto WriteAll(int fd, std::string_view data) -> bool
+{
+  while (!data.empty())
+  {
+    const ssize_t written = ::write(fd, data.data(), data.size());
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return false;
+    }
+
+    data.remove_prefix(static_cast<std::size_t>(written));
+  }
+
+  return true;
+}
+
+auto ParseNumber(std::string_view &data, u64 &value) -> bool
+{
+  auto [end, ec] = std::from_chars(data.begin(), data.end(), value);
+  if (ec != std::errc {} || end == data.end() || *end != ' ')
+  {
+    return false;
+  }
+
+  data.remove_prefix(static_cast<std::size_t>(end - data.begin()) + 1);
+  return true;
+}
+
+} // namespace
+
+BindingJournal::BindingJournal(
+  std::string snapshot_file_name,
+  std::string journal_file_name)
+  : snapshot_file_name_(std::move(snapshot_file_name)),
+    journal_file_name_(std::move(journal_file_name))
+{
+  fd_ = ::open(
+    journal_file_name_.c_str(),
+    O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+    0644);
+
+  if (fd_ < 0)
+  {
+    Print(
+      "Constructor",
+      "couldn't open {}: {}",
+      journal_file_name_,
+      std::strerror(errno));
+  }
+
+  flusher_ = std::thread([this] { Flusher(); });
+}
+
+BindingJournal::~BindingJournal()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  flusher_.join();
+
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+  }
+}
+
+void BindingJournal::Replay(
+  const std::function<void(const Record&)> &callback)
+{
+  if (fd_ < 0)
+  {
+    return;
+  }
+
+  std::string data;
+  std::array<char, 4096> chunk;
+  ::lseek(fd_, 0, SEEK_SET);
+  for (ssize_t got; (got = ::read(fd_, chunk.data(), chunk.size())) != 0;)
+  {
+    if (got < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      Print("Replay()", "read failed: {}", std::strerror(errno));
+      return;
+    }
+
+    data.append(chunk.data(), static_cast<std::size_t>(got));
+  }
+
+  std::string_view remaining = data;
+  Record record;
+  u32 replayed = 0;
+  while (!remaining.empty())
+  {
+    const std::size_t size = Decode(remaining, record);
+    if (size == 0)
+    {
+      break;
+    }
+
+    callback(record);
+    remaining.remove_prefix(size);
+    ++replayed;
+  }
+
+  if (!remaining.empty())
+  {
+    // most likely a crash in the middle of an append
+    Print("Replay()", "dropping torn tail: {} bytes", remaining.size());
+    if (::ftruncate(fd_, static_cast<off_t>(data.size() - remaining.size())))
+    {
+      Print("Replay()", "truncate failed: {}", std::strerror(errno));
+    }
+  }
+
+  std::scoped_lock lock(mutex_);
+  records_ += replayed;
+  Debug("Replay()", "replayed: {}", replayed);
+}
+
+void BindingJournal::Append(
+  Operation operation,
+  u64 channel,
+  std::string_view client)
+{
+  {
+    std::scoped_lock lock(mutex_);
+    pending_ += Encode(operation, channel, client);
+    ++records_;
+  }
+  wake_.notify_one();
+}
+
+auto BindingJournal::NeedsCompaction() -> bool
+{
+  std::scoped_lock lock(mutex_);
+  return records_ >= JOURNAL_COMPACT_RECORDS;
+}
+
+void BindingJournal::Compact(std::string &&snapshot)
+{
+  {
+    std::scoped_lock lock(mutex_);
+    snapshot_ = std::move(snapshot);
+    // whatever is pending so far is covered by the snapshot
+    snapshot_covers_ = pending_.size();
+    records_ = 0;
+  }
+  wake_.notify_one();
+}
+
+void BindingJournal::Flusher()
+{
+  std::unique_lock lock(mutex_);
+  while (true)
+  {
+    wake_.wait(lock, [this] {
+      return stopping_ || !pending_.empty() || snapshot_.has_value();
+    });
+
+    auto snapshot = std::exchange(snapshot_, std::nullopt);
+    auto records = std::exchange(pending_, {});
+    const std::size_t covered = std::exchange(snapshot_covers_, 0);
+    lock.unlock();
+
+    std::string_view to_write = records;
+    if (snapshot.has_value() && WriteSnapshot(*snapshot))
+    {
+      // a crash before the truncate only replays records the snapshot
+      // already has, which ends up in the same table
+      if (fd_ >= 0 && ::ftruncate(fd_, 0) != 0)
+      {
+        Print("Flusher()", "truncate failed: {}", std::strerror(errno));
+      }
+      to_write.remove_prefix(covered);
+    }
+
+    if (!to_write.empty())
+    {
+      WriteRecords(to_write);
+    }
+
+    lock.lock();
+    if (stopping_ && pending_.empty() && !snapshot_.has_value())
+    {
+      return;
+    }
+
+    // anything appended meanwhile is grouped into the next fsync
+    wake_.wait_for(
+      lock,
+      std::chrono::milliseconds(JOURNAL_SYNC_MS),
+      [this] { return stopping_; });
+  }
+}
+
+auto BindingJournal::WriteSnapshot(const std::string &snapshot) -> bool
+{
+  const std::string tmp_file_name = snapshot_file_name_ + ".tmp";
+
+  const int fd = ::open(
+    tmp_file_name.c_str(),
+    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+    0644);
+  if (fd < 0)
+  {
+    Print("WriteSnapshot()", "open failed: {}", std::strerror(errno));
+    return false;
+  }
+
+  const bool written = WriteAll(fd, snapshot) && ::fsync(fd) == 0;
+  ::close(fd);
+
+  if (!written ||
+      std::rename(tmp_file_name.c_str(), snapshot_file_name_.c_str()) != 0)
+  {
+    Print("WriteSnapshot()", "failed: {}", std::strerror(errno));
+    return false;
+  }
+
+  // makes the rename itself durable
+  auto directory =
+    std::filesystem::path(snapshot_file_name_).parent_path().string();
+  const int directory_fd = ::open(
+    directory.empty() ? "." : directory.c_str(),
+    O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (directory_fd >= 0)
+  {
+    ::fsync(directory_fd);
+    ::close(directory_fd);
+  }
+
+  Debug("WriteSnapshot()", "bytes: {}", snapshot.size());
+  return true;
+}
+
+auto BindingJournal::WriteRecords(std::string_view records) -> bool
+{
+  if (fd_ < 0 || !WriteAll(fd_, records) || ::fdatasync(fd_) != 0)
+  {
+    Print("WriteRecords()", "failed: {}", std::strerror(errno));
+    return false;
+  }
+
+  Debug("WriteRecords()", "bytes: {}", records.size());
+  return true;
+}
+
+auto BindingJournal::Encode(
+  Operation operation,
+  u64 channel,
+  std::string_view client) -> std::string
+{
+  return fmt::format(
+    "{} {} {} {}\n",
+    static_cast<char>(operation),
+    channel,
+    client.size(),
+    client);
+}
+
+auto BindingJournal::Decode(std::string_view data, Record &record)
+  -> std::size_t
+{
+  const std::size_t total = data.size();
+
+  if (data.size() < 2 || data[1] != ' ' ||
+      (data[0] != static_cast<char>(Operation::bind) &&
+       data[0] != static_cast<char>(Operation::unbind)))
+  {
+    return 0;
+  }
+  record.operation = static_cast<Operation>(data[0]);
+  data.remove_prefix(2);
+
+  u64 size = 0;
+  if (!ParseNumber(data, record.channel) || !ParseNumber(data, size) ||
+      data.size() <= size || data[size] != '\n')
+  {
+    return 0;
+  }
+
+  record.client.assign(data.substr(0, size));
+  data.remove_prefix(size + 1);
+
+  return total - data.size();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/Logger.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+
+namespace bridge
+{
+
+// Append-only log of binding changes, the snapshot plus the journal is the
+// whole binding table.
+//
+// Appends only hit memory, a background thread writes them out and fsyncs
+// them as a group at most once per JOURNAL_SYNC_MS. Compacting hands over a
+// full snapshot which is written next to the old one and renamed over it,
+// only then is the journal truncated.
+constexpr char BINDINGJOURNAL_STR[] = "BindingJournal";
+class BindingJournal
+  : private Logger<BINDINGJOURNAL_STR>
+{
+public:
+  enum class Operation : char
+  {
+    bind = '+',
+    unbind = '-'
+  };
+
+  struct Record
+  {
+    Operation operation;
+    u64 channel;
+    std::string client;
+  };
+
+private:
+  std::string snapshot_file_name_;
+  std::string journal_file_name_;
+  int fd_ = -1;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  // encoded records that aren't written yet
+  std::string pending_;
+  std::optional<std::string> snapshot_;
+  // how much of pending_ the snapshot already covers
+  std::size_t snapshot_covers_ = 0;
+  // records in the journal since the last compaction
+  u32 records_ = 0;
+  bool stopping_ = false;
+
+  std::thread flusher_;
+
+public:
+  [[nodiscard]] BindingJournal(
+    std::string snapshot_file_name,
+    std::string journal_file_name);
+
+  // Everything appended so far is on disk once this returns
+  ~BindingJournal();
+
+  BindingJournal(const BindingJournal&) = delete;
+  BindingJournal& operator=(const BindingJournal&) = delete;
+
+  // Calls back with every complete record of the journal in order, a torn
+  // record at the end is cut off so new records don't land after it
+  void Replay(const std::function<void(const Record&)> &callback);
+
+  void Append(Operation operation, u64 channel, std::string_view client);
+
+  [[nodiscard]] auto NeedsCompaction() -> bool;
+
+  // The snapshot has to cover every record appended before this call
+  void Compact(std::string &&snapshot);
+
+private:
+  void Flusher();
+
+  // tmp file, fsync, rename over the old one, fsync the directory
+  auto WriteSnapshot(const std::string &snapshot) -> bool;
+
+  auto WriteRecords(std::string_view records) -> bool;
+
+  // "+ <channel> <size> <client>\n", the size keeps any client name intact
+  [[nodiscard]] static auto Encode(
+    Operation operation,
+    u64 channel,
+    std::string_view client) -> std::string;
+
+  // Returns the size of the record or 0 if it's torn or malformed
+  [[nodiscard]] static auto Decode(std::string_view data, Record &record)
+    -> std::size_t;
+};
+
+} // bridge
@@ -8,7 +8,7 @@ std::vector<BotCommandPtr> BotCommand::commands_list_;
 auto BotCommand::Create(
   BotChatSession& bot,
   const BotSettingsPtr& settings,
-  dpp::slashcommand&& command) -> BotCommandPtr
+  DiscordCommandSpec&& command) -> BotCommandPtr
 {
 
   auto ptr = BotCommandPtr(
@@ -16,7 +16,7 @@ auto BotCommand::Create(
       settings,
       std::forward<decltype(command)>(command)));
 
-  bot.bot_.global_command_create(ptr->command_, bot.BindToLogger());
+  bot.gateway_->RegisterCommand(ptr->command_, bot.BindToLogger());
   commands_list_.push_back(ptr);
 
   return ptr;
@@ -24,7 +24,7 @@ auto BotCommand::Create(
 
 BotCommand::BotCommand(
   const BotSettingsPtr& settings,
-  dpp::slashcommand&& command)
+  DiscordCommandSpec&& command)
   : settings(settings),
     command_(std::forward<decltype(command)>(command)) {}
 
@@ -37,9 +37,9 @@ auto BotCommand::SetCallable(
   return *this;
 }
 
-void BotCommand::Call(const dpp::slashcommand_t &event)
+void BotCommand::Call(const DiscordCommand &event)
 {
-  const std::string &command_name = event.command.get_command_name();
+  const std::string &command_name = event.name;
 
   bool found = false;
 
@@ -77,22 +77,31 @@ void BotCommand::Call(const dpp::slashcommand_t &event)
 }
 
 BotChatSession::BotChatSession(
-  const std::shared_ptr<ThreadSafeChatRoom> &room)
+  const std::shared_ptr<ThreadSafeChatRoom> &room,
+  DiscordGatewayPtr &&gateway,
+  asio::io_context &io)
   : room_(room),
-    bot_(TOKEN, dpp::i_default_intents | dpp::i_message_content)
+    gateway_(std::move(gateway)),
+    dispatcher_(io, *gateway_),
+    outbox_(
+      io,
+      [this](u64 channel, std::string &&content) {
+        dispatcher_.Send(channel, std::move(content));
+      },
+      std::chrono::milliseconds(DISCORD_COALESCE_MS))
 {
-  Debug("Constructor", "Application ID: {}", static_cast<u64>(bot_.me.id));
+  Debug("Constructor", "Application ID: {}", gateway_->Self());
 
   settings_ = std::make_shared<BotSettings>();
 
-  bot_.on_message_create(
+  gateway_->OnMessage(
     BindToThis(&BotChatSession::OnMessageCreate, this));
   Debug("Constructor", "bound OnMessageCreate");
 
-  bot_.on_slashcommand(
+  gateway_->OnCommand(
     BindToThis(&BotChatSession::OnSlashCommand, this));
 
-  bot_.on_ready(BindToThis(&BotChatSession::OnReady, this));
+  gateway_->OnReady([this] { OnReady(); });
   Debug("Constructor", "bound OnReady");
 }
 
@@ -100,16 +109,16 @@ BotChatSession::~BotChatSession() { room_->Leave(shared_from_this()); }
 
 void BotChatSession::Start()
 {
-  bot_.start(dpp::st_return);
+  gateway_->Start();
   Debug("Start()", "bot started");
 
   room_->Join(shared_from_this());
 }
 
 void BotChatSession::OnMessageCreate(
-  const dpp::message_create_t &event)
+  const DiscordMessage &event)
 {
-  if (event.msg.author.id == bot_.me.id)
+  if (event.author == gateway_->Self())
   {
     // well I pretty much know when I write messages...
     return;
@@ -117,78 +126,66 @@ void BotChatSession::OnMessageCreate(
 
   Debug(
     "OnMessageCreate()", "message: {}, channel: {}",
-    event.msg.content,
-    static_cast<u64>(event.msg.channel_id));
+    event.content,
+    event.channel);
 
-  auto formatted_msg = MessageFormatter::ConstructJson({
-    event.msg.author.global_name,
-    event.msg.content,
+  // the json is only rendered once a client actually gets it
+  auto formatted_msg = ChatMessage::Create({
+    event.author_name,
+    event.content,
     "Discord"});
 
   room_->DeliverMessage(shared_from_this(), formatted_msg);
+  messages_in.Add();
   Debug("OnMessageCreate()", "delivered message");
 }
 
-void BotChatSession::OnSlashCommand(const dpp::slashcommand_t &event)
+void BotChatSession::OnSlashCommand(const DiscordCommand &event)
 {
-  Debug("OnSlashCommand()", "command: {}", event.command.get_command_name());
+  Debug("OnSlashCommand()", "command: {}", event.name);
 
   BotCommand::Call(event);
 
-  Debug(
-    "OnSlashCommand()",
-    "command processed: {}",
-    event.command.get_command_name());
+  Debug("OnSlashCommand()", "command processed: {}", event.name);
 }
 
-void BotChatSession::OnReady([[maybe_unused]] const dpp::ready_t &event)
+void BotChatSession::OnReady()
 {
-  if (dpp::run_once<struct register_global_commands>())
-  {
+  std::call_once(commands_registered_, [this] {
     Debug("OnReady()");
     try
     {
-      dpp::slashcommand slashcmd = dpp::slashcommand
-        {
-          "bindclient",
-          "Binds a client to this specific channel",
-          bot_.me.id
-        }
-        .add_option({
-          dpp::co_string,
-          "client",
-          "The client to be bound to this channel",
-          true});
-
       BotCommand::Create(
         *this,
         settings_,
-        std::move(slashcmd))
+        {
+          "bindclient",
+          "Binds a client to this specific channel",
+          {{
+            "client",
+            "The client to be bound to this channel",
+            true}}
+        })
         ->SetCallable(
           [self = shared_from_this()]
-          (BotCommand& command, const dpp::slashcommand_t event) {
+          (BotCommand& command, const DiscordCommand& event) {
             self->HandleBindCommand(command, event);
           });
 
-      slashcmd = dpp::slashcommand
-        {
-          "unbindclient",
-          "Unbinds a specific client from this channel",
-          bot_.me.id
-        }
-        .add_option({
-          dpp::co_string,
-          "client",
-          "The client to be unbound from this channel",
-          true});
-
       BotCommand::Create(
         *this,
         settings_,
-        std::move(slashcmd))
+        {
+          "unbindclient",
+          "Unbinds a specific client from this channel",
+          {{
+            "client",
+            "The client to be unbound from this channel",
+            true}}
+        })
         ->SetCallable(
           [self = shared_from_this()]
-          (BotCommand& command, const dpp::slashcommand_t event) {
+          (BotCommand& command, const DiscordCommand& event) {
             self->HandleUnbindCommand(command, event);
           });
 
@@ -198,11 +195,11 @@ void BotChatSession::OnReady([[maybe_unused]] const dpp::ready_t &event)
         {
           "listclients",
           "Lists all clients bound to this channel",
-          bot_.me.id
+          {}
         })
         ->SetCallable(
           [self = shared_from_this()]
-          (BotCommand& command, const dpp::slashcommand_t event) {
+          (BotCommand& command, const DiscordCommand& event) {
             self->HandleListBoundCommand(command, event);
           });
     }
@@ -210,23 +207,23 @@ void BotChatSession::OnReady([[maybe_unused]] const dpp::ready_t &event)
     {
       Debug("OnReady()", "error: {}", e.what());
     }
-  }
+  });
 }
 
 void BotChatSession::HandleBindCommand(
   const BotCommand& command,
-  const dpp::slashcommand_t& event)
+  const DiscordCommand& event)
 {
   Debug("handle_bind_command()");
-  if (dpp::snowflake channel_id = event.command.channel_id)
+  if (const u64 channel_id = event.channel)
   {
-    std::string client = std::get<std::string>(event.get_parameter("client"));
+    std::string client = event.Option("client");
     if (command.settings->BindClient(client, channel_id))
     {
       event.reply(fmt::format(
         "Successfully bound client `{}` to channel with ID: `{}`",
         client,
-        static_cast<u64>(channel_id)));
+        channel_id));
     }
     else
     {
@@ -239,33 +236,33 @@ void BotChatSession::HandleBindCommand(
 
 void BotChatSession::HandleUnbindCommand(
   const BotCommand& command,
-  const dpp::slashcommand_t& event)
+  const DiscordCommand& event)
 {
-  if (dpp::snowflake channel_id = event.command.channel_id)
+  if (const u64 channel_id = event.channel)
   {
-    std::string client = std::get<std::string>(event.get_parameter("client"));
+    std::string client = event.Option("client");
     if (command.settings->UnbindClient(client, channel_id))
     {
       event.reply(fmt::format(
         "Successfully unbound client `{}` from channel with ID: `{}`",
         client,
-        static_cast<u64>(channel_id)));
+        channel_id));
     }
     else
     {
       event.reply(fmt::format(
         "Client `{}` is not bound to channel with ID: `{}`!",
         client,
-        static_cast<u64>(channel_id)));
+        channel_id));
     }
   }
 }
 
 void BotChatSession::HandleListBoundCommand(
   const BotCommand& command,
-  const dpp::slashcommand_t& event)
+  const DiscordCommand& event)
 {
-  if (dpp::snowflake channel_id = event.command.channel_id)
+  if (const u64 channel_id = event.channel)
   {
     try
     {
@@ -281,39 +278,26 @@ void BotChatSession::HandleListBoundCommand(
 
 void BotChatSession::DeliverMessage(
   const ChatRoomParticipantPtr &participant,
-  const std::string &message)
+  const ChatMessagePtr &message)
 {
   if (participant.get() == this)
   {
     return;
   }
 
-  MessageParser parser(message);
-  auto client_result = parser.GetClient();
-  if (!client_result.has_value())
-  {
-    return;
-  }
-
-  auto channels_view = settings_->GetChannelList(client_result.value());
+  // the bindings as of this message, a bind meanwhile publishes a new table
+  // and leaves this one alone
+  auto routes = settings_->GetRoutes();
+  auto channels_view = routes->GetChannelList(message->Client());
   if (channels_view.empty())
   {
     return;
   }
 
-  std::string formatted;
-  try
-  {
-    formatted = fmt::format("{}", parser);
-  }
-  catch (std::exception& e)
-  {
-    Debug("DeliverMessage()", "error: {}", e.what());
-    return;
-  }
-
-  std::ranges::for_each(channels_view, [this, &formatted](u64 channel) {
-    bot_.message_create({channel, formatted}, BindToLogger());
+  // the line is rendered once, on the outbox's strand, and not copied
+  std::ranges::for_each(channels_view, [this, &message](u64 channel) {
+    outbox_.Post(channel, message);
+    messages_out.Add();
     Debug("DeliverMessage()", "Channel Found: {}", channel);
   });
 }
@@ -326,11 +310,15 @@ auto BotChatSession::BindToLogger() -> logger_cb_t
 auto BotChatSession::BindToLogger(
   logger_cb_t &callable) -> logger_cb_t
 {
-  return [callable](const dpp::confirmation_callback_t &result)
+  return [callable](const DiscordResult &result)
   {
-    if (result.is_error())
+    if (result.IsError())
     {
-      Debug("BindToLogger()", "error: {}", result.get_error().message);
+      Debug(
+        "BindToLogger()",
+        "error: {} {}",
+        result.status,
+        result.error);
       return;
     }
 
@@ -3,6 +3,9 @@
 #include "common/common.hpp"
 #include "common/ChatRoom.hpp"
 #include "BotSettings.hpp"
+#include "DiscordDispatcher.hpp"
+#include "DiscordGateway.hpp"
+#include "DiscordOutbox.hpp"
 
 namespace bridge
 {
@@ -17,8 +20,24 @@ class BotChatSession final
 {
 
   std::shared_ptr<ThreadSafeChatRoom> room_;
-  dpp::cluster bot_;
+  // DPP or a local fake, everything Discord goes through here
+  DiscordGatewayPtr gateway_;
+  // ordered and paced sends, per channel
+  DiscordDispatcher dispatcher_;
+  // what goes to Discord is coalesced per channel first
+  DiscordOutbox outbox_;
   BotSettingsPtr settings_;
+  // ready fires again on every reconnect
+  std::once_flag commands_registered_;
+
+  static inline Counter messages_in {
+    "bridge_messages_in_total",
+    "Messages handed to the room, per participant type",
+    "participant=\"discord\""};
+  static inline Counter messages_out {
+    "bridge_messages_out_total",
+    "Messages written out, per participant type",
+    "participant=\"discord\""};
 
   // this relation is used so the Command can register itself
   friend class BotCommand;
@@ -30,8 +49,11 @@ class BotChatSession final
     return boost::bind(ptr, self, _1);
   }
 public:
+  // The outbound messages are coalesced on io
   [[nodiscard]] BotChatSession(
-    const std::shared_ptr<ThreadSafeChatRoom> &room);
+    const std::shared_ptr<ThreadSafeChatRoom> &room,
+    DiscordGatewayPtr &&gateway,
+    asio::io_context &io);
 
   ~BotChatSession();
 
@@ -39,34 +61,34 @@ public:
   void Start();
 
 private:
-  void OnMessageCreate(const dpp::message_create_t &event);
+  void OnMessageCreate(const DiscordMessage &event);
 
-  void OnSlashCommand(const dpp::slashcommand_t &event);
+  void OnSlashCommand(const DiscordCommand &event);
 
-  void OnReady([[maybe_unused]] const dpp::ready_t &event);
+  void OnReady();
 
   void HandleBindCommand(
     const BotCommand& command,
-    const dpp::slashcommand_t& event);
+    const DiscordCommand& event);
 
   void HandleUnbindCommand(
     const BotCommand& command,
-    const dpp::slashcommand_t& event);
+    const DiscordCommand& event);
 
   void HandleListBoundCommand(
     const BotCommand& command,
-    const dpp::slashcommand_t& event);
+    const DiscordCommand& event);
 
   void DeliverMessage(
     const ChatRoomParticipantPtr &participant,
-    const std::string &message) override;
+    const ChatMessagePtr &message) override;
 
   // The code below is used to bind to any DPP event
   using logger_cb_t =
-    std::function<void(const dpp::confirmation_callback_t&)>;
+    std::function<void(const DiscordResult&)>;
 
   static inline logger_cb_t default_cb_t
-    = [](const dpp::confirmation_callback_t&) {};
+    = [](const DiscordResult&) {};
 
   static auto BindToLogger() -> logger_cb_t;
 
@@ -84,19 +106,19 @@ class BotCommand final
   static std::vector<BotCommandPtr> commands_list_;
 
   using command_callable_t =
-    std::function<void(BotCommand&, const dpp::slashcommand_t&)>;
+    std::function<void(BotCommand&, const DiscordCommand&)>;
 
 public:
   BotSettingsPtr settings;
 
 private:
-  dpp::slashcommand command_;
+  DiscordCommandSpec command_;
   command_callable_t callable_;
   bool is_set_ = false;
 
   [[nodiscard]] BotCommand(
     const BotSettingsPtr& settings,
-    dpp::slashcommand&& command);
+    DiscordCommandSpec&& command);
 
   void InitializeCommand(BotChatSession& bot);
 
@@ -106,10 +128,10 @@ public:
   static auto Create(
     BotChatSession& bot,
     const BotSettingsPtr& settings,
-    dpp::slashcommand&& command)
+    DiscordCommandSpec&& command)
     -> BotCommandPtr;
 
-  static void Call(const dpp::slashcommand_t &event);
+  static void Call(const DiscordCommand &event);
 };
 
 } // bridge
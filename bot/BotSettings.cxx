@@ -1,50 +1,127 @@
 #include "BotSettings.hpp"
-#include "Defer.hpp"
 
 using namespace bridge;
 
-BotSettings::BotSettings() { LoadClients(); }
+namespace
+{
 
-BotSettings::~BotSettings() { FlushAll(); }
+// Fibonacci hashing, the top bits of the product depend on all of the hash,
+// a channel's snowflake alone differs mostly in its low bits
+auto ShardOfHash(u64 hash) -> std::size_t
+{
+  return (hash * 0x9E3779B97F4A7C15) >> (64 - ROUTING_SHARD_BITS);
+}
 
-auto BotSettings::BindClient(
-  const std::string &client,
-  dpp::snowflake channel) -> bool
+// The entry in shard at key, or an empty span
+template <typename Shard, typename Key>
+auto FindEntry(const std::shared_ptr<const Shard> &shard, const Key &key)
+  -> std::span<const typename Shard::mapped_type::element_type::value_type>
 {
-  Defer<true> flush([this] { FlushClients(); });
+  if (shard == nullptr)
+  {
+    return {};
+  }
 
-  ptree obj;
-  obj.add("client", client);
-  obj.add("channel", static_cast<u64>(channel));
+  auto found = shard->find(key);
+  if (found == shard->end())
+  {
+    return {};
+  }
 
-  auto result =
-    detail::TreeGetChild(client_to_channel_, "values");
+  return *found->second;
+}
 
-  if (result.has_value())
+// What the pointer points to, for the writer to change. Copied first when
+// it's missing or a published table holds it as well, it's always made as a
+// non-const T, so casting the const away is fine
+template <typename T>
+auto Writable(std::shared_ptr<const T> &shared) -> T&
+{
+  if (shared == nullptr || shared.use_count() > 1)
   {
-    auto &value_array = result.value().get();
-    try
-    {
-      if (CheckClientExists(value_array, client, channel))
-      {
-        flush.Cancel();
-        return false;
-      }
-
-      PushClient(value_array, obj);
-      return true;
-    }
-    catch (std::exception &e)
-    {
-      Debug("bind_client_to_channel()", "error: {}", e.what());
-      // value not found is a normal thing, nothing really exceptional
-    }
+    shared = shared == nullptr ? std::make_shared<T>()
+                               : std::make_shared<T>(*shared);
   }
 
-  ptree array;
-  array.push_back(std::make_pair("", obj));
-  client_to_channel_.add_child("values", array);
+  return const_cast<T&>(*shared);
+}
+
+} // namespace
+
+auto RoutingTable::ShardOf(const HashedClient &client) -> std::size_t
+{
+  return ShardOfHash(client.hash);
+}
 
+auto RoutingTable::ShardOf(u64 channel) -> std::size_t
+{
+  return ShardOfHash(channel);
+}
+
+auto RoutingTable::GetChannelList(std::string_view client) const
+  -> std::span<const u64>
+{
+  return GetChannelList(HashedClient(client));
+}
+
+auto RoutingTable::GetChannelList(const HashedClient &client) const
+  -> std::span<const u64>
+{
+  return FindEntry(client_to_channels[ShardOf(client)], client);
+}
+
+auto RoutingTable::GetClientList(u64 channel) const
+  -> std::span<const std::string>
+{
+  return FindEntry(channel_to_clients[ShardOf(channel)], channel);
+}
+
+BotSettings::BotSettings()
+  : journal_(client_to_channel_file_name, client_to_channel_journal_name),
+    routes_(std::make_unique<const RoutingTable>())
+{
+  LoadClients();
+}
+
+BotSettings::~BotSettings()
+{
+  std::scoped_lock lock(write_mutex_);
+  FlushAll();
+}
+
+auto BotSettings::GetChannelList(std::string_view client) const
+  -> std::vector<u64>
+{
+  auto routes = GetRoutes();
+  auto channels = routes->GetChannelList(client);
+  return {channels.begin(), channels.end()};
+}
+
+auto BotSettings::GetClientList(dpp::snowflake channel) const
+  -> std::vector<std::string>
+{
+  auto routes = GetRoutes();
+  auto clients = routes->GetClientList(static_cast<u64>(channel));
+  return {clients.begin(), clients.end()};
+}
+
+auto BotSettings::BindClient(
+  const std::string &client,
+  dpp::snowflake channel) -> bool
+{
+  std::scoped_lock lock(write_mutex_);
+  if (!InsertBinding(client, static_cast<u64>(channel)))
+  {
+    Debug("BindClient()", "already bound: {}", client);
+    return false;
+  }
+  PublishRoutes();
+
+  journal_.Append(
+    BindingJournal::Operation::bind,
+    static_cast<u64>(channel),
+    client);
+  MaybeCompactClients();
   return true;
 }
 
@@ -52,51 +129,80 @@ auto BotSettings::UnbindClient(
   const std::string &client,
   dpp::snowflake channel) -> bool
 {
-  auto result =
-    detail::TreeGetChild(client_to_channel_, "values");
-
-  if (!result.has_value())
+  std::scoped_lock lock(write_mutex_);
+  if (!EraseBinding(client, static_cast<u64>(channel)))
   {
     return false;
   }
+  PublishRoutes();
 
-  auto &value_array = result.value().get();
-
-  // erase if is not allowed since value_array's iterators are constant
-  auto found =
-    std::ranges::find_if(value_array, PairFinder(client, channel));
+  journal_.Append(
+    BindingJournal::Operation::unbind,
+    static_cast<u64>(channel),
+    client);
+  MaybeCompactClients();
+  return true;
+}
 
-  if (found == value_array.end())
+auto BotSettings::InsertBinding(const std::string &client, u64 channel)
+  -> bool
+{
+  const HashedClient hashed(client);
+  const auto bound = table_.GetChannelList(hashed);
+  if (std::ranges::find(bound, channel) != bound.end())
   {
     return false;
   }
 
-  value_array.erase(found);
-  FlushClients();
+  auto &channels = Writable(table_.client_to_channels[
+    RoutingTable::ShardOf(hashed)]);
+  Writable(channels[client]).push_back(channel);
+
+  auto &clients = Writable(table_.channel_to_clients[
+    RoutingTable::ShardOf(channel)]);
+  Writable(clients[channel]).push_back(client);
   return true;
 }
 
-auto BotSettings::CheckClientExists(
-  const ptree &value_array,
-  const std::string &client,
-  dpp::snowflake channel) -> bool
+auto BotSettings::EraseBinding(const std::string &client, u64 channel) -> bool
 {
+  const HashedClient hashed(client);
+  const auto bound = table_.GetChannelList(hashed);
+  if (std::ranges::find(bound, channel) == bound.end())
+  {
+    return false;
+  }
 
-  bool found =
-    std::ranges::find_if(value_array, PairFinder(client, channel)) !=
-    value_array.end();
+  // both directions always hold the pair, the find above is enough
+  auto &channels = Writable(table_.client_to_channels[
+    RoutingTable::ShardOf(hashed)]);
+  auto found_client = channels.find(hashed);
+  std::erase(Writable(found_client->second), channel);
+  if (found_client->second->empty())
+  {
+    channels.erase(found_client);
+  }
 
-  Debug("check_client_to_channel()", "found: {}", found);
-  return found;
+  auto &clients = Writable(table_.channel_to_clients[
+    RoutingTable::ShardOf(channel)]);
+  auto found_channel = clients.find(channel);
+  std::erase(Writable(found_channel->second), client);
+  if (found_channel->second->empty())
+  {
+    clients.erase(found_channel);
+  }
+  return true;
 }
 
-void BotSettings::PushClient(ptree &value_array, const ptree &obj)
+void BotSettings::PublishRoutes()
 {
-  value_array.push_back(std::make_pair("", obj));
+  // only the shard pointers, everything else is shared
+  routes_.Publish(std::make_unique<const RoutingTable>(table_));
 }
 
 auto BotSettings::LoadSettings(dpp::snowflake guild) -> bool
 {
+  std::scoped_lock lock(write_mutex_);
   std::string file_name =
     fmt::format("settings_{}.json", static_cast<u64>(guild));
 
@@ -115,23 +221,85 @@ auto BotSettings::LoadSettings(dpp::snowflake guild) -> bool
 auto BotSettings::LoadClients() -> bool
 {
   auto tree = TreeFromFile(client_to_channel_file_name);
-  if (!tree.has_value())
+  auto values = tree.has_value()
+                ? tree.value()->get_child_optional("values")
+                : boost::none;
+  if (values)
   {
-    return false;
+    for (auto &[_, element] : *values)
+    {
+      auto client = detail::TreeGetValue<std::string>(element, "client");
+      auto channel = detail::TreeGetValue<u64>(element, "channel");
+      if (!client.has_value() || !channel.has_value())
+      {
+        Debug("LoadClients()", "skipping malformed binding");
+        continue;
+      }
+
+      InsertBinding(client.value(), channel.value());
+    }
   }
 
-  client_to_channel_ = std::move(*tree.value());
-  return true;
+  // binding twice or unbinding what's not there is a no-op, so replaying
+  // records the snapshot already has is harmless
+  journal_.Replay([this](const BindingJournal::Record &record) {
+    if (record.operation == BindingJournal::Operation::bind)
+    {
+      InsertBinding(record.client, record.channel);
+      return;
+    }
+
+    EraseBinding(record.client, record.channel);
+  });
+
+  // a single table for everything loaded, nobody reads yet, so the shards
+  // were changed in place
+  PublishRoutes();
+  MaybeCompactClients();
+  return tree.has_value();
+}
+
+void BotSettings::MaybeCompactClients()
+{
+  if (journal_.NeedsCompaction())
+  {
+    CompactClients();
+  }
 }
 
-void BotSettings::FlushClients()
+void BotSettings::CompactClients()
 {
-  TreeToFile(client_to_channel_, client_to_channel_file_name);
+  ptree array;
+  for (const auto &shard : table_.client_to_channels)
+  {
+    if (shard == nullptr)
+    {
+      continue;
+    }
+
+    for (const auto &[client, channels] : *shard)
+    {
+      for (u64 channel : *channels)
+      {
+        ptree obj;
+        obj.add("client", client);
+        obj.add("channel", channel);
+        array.push_back(std::make_pair("", obj));
+      }
+    }
+  }
+
+  ptree tree;
+  tree.add_child("values", array);
+
+  std::ostringstream stream;
+  write_json(stream, tree);
+  journal_.Compact(std::move(stream).str());
 }
 
 void BotSettings::FlushAll()
 {
-  FlushClients();
+  CompactClients();
   for (const auto &[key, value] : guild_to_settings_)
   {
     std::string file_name =
@@ -2,89 +2,152 @@
 
 #include "common/common.hpp"
 #include "common/MessageFormat.hpp"
+#include "common/Rcu.hpp"
 #include "common/util.hpp"
+#include "BindingJournal.hpp"
 
 namespace bridge
 {
 
 using namespace boost::property_tree;
 
+// a side of the routing table is hashed into this many shards
+inline constexpr u32 ROUTING_SHARD_BITS = 6;
+inline constexpr std::size_t ROUTING_SHARDS = 1 << ROUTING_SHARD_BITS;
+
+// A client's name with its hash, which picks the shard and is reused for
+// the lookup in there
+struct HashedClient
+{
+  std::string_view name;
+  std::size_t hash;
+
+  [[nodiscard]] explicit HashedClient(std::string_view client)
+    : name(client),
+      hash(detail::StringHash {}(client))
+  {
+  }
+};
+
+struct HashedClientHash
+  : detail::StringHash
+{
+  using detail::StringHash::operator();
+
+  [[nodiscard]] auto operator()(const HashedClient &client) const
+    -> std::size_t
+  {
+    return client.hash;
+  }
+};
+
+struct HashedClientEqual
+{
+  using is_transparent = void;
+
+  [[nodiscard]] auto operator()(
+    std::string_view lhs,
+    std::string_view rhs) const -> bool
+  {
+    return lhs == rhs;
+  }
+
+  [[nodiscard]] auto operator()(
+    const HashedClient &lhs,
+    std::string_view rhs) const -> bool
+  {
+    return lhs.name == rhs;
+  }
+
+  [[nodiscard]] auto operator()(
+    std::string_view lhs,
+    const HashedClient &rhs) const -> bool
+  {
+    return lhs == rhs.name;
+  }
+};
+
+// Who is bound to what, both directions. Once published it is never
+// changed, a bind publishes a new one. Shards and entries are immutable and
+// shared between tables, a new table copies the shard pointers and only the
+// shards and entries a bind touched are new, a missing shard is an empty one
+struct RoutingTable
+{
+  using ClientShard = std::unordered_map<
+    std::string,
+    std::shared_ptr<const std::vector<u64>>,
+    HashedClientHash,
+    HashedClientEqual>;
+  using ChannelShard =
+    std::unordered_map<u64, std::shared_ptr<const std::vector<std::string>>>;
+
+  std::array<std::shared_ptr<const ClientShard>, ROUTING_SHARDS>
+    client_to_channels;
+  std::array<std::shared_ptr<const ChannelShard>, ROUTING_SHARDS>
+    channel_to_clients;
+
+  [[nodiscard]] static auto ShardOf(const HashedClient &client)
+    -> std::size_t;
+
+  [[nodiscard]] static auto ShardOf(u64 channel) -> std::size_t;
+
+  // The channels the client is bound to
+  [[nodiscard]] auto GetChannelList(std::string_view client) const
+    -> std::span<const u64>;
+
+  [[nodiscard]] auto GetChannelList(const HashedClient &client) const
+    -> std::span<const u64>;
+
+  // The clients bound to the channel
+  [[nodiscard]] auto GetClientList(u64 channel) const
+    -> std::span<const std::string>;
+};
+
 constexpr char BOTSETTINGS_STR[] = "BotSettings";
+// Binds and unbinds come from the slash command threads, the message path
+// reads from the io threads. Writers take write_mutex_ and change table_,
+// copying the shards and entries a published table still shares, then
+// publish a copy of it. Readers only ever see published copies through
+// GetRoutes(), and neither side waits on the other
 class BotSettings
   : public Logger<BOTSETTINGS_STR>
 {
-  ptree client_to_channel_;
+  // serializes everything below, the readers don't take it
+  std::mutex write_mutex_;
+  // the writer's copy, ahead of routes_ only while a write is in progress.
+  // What it shares with a published table is copied before it's changed
+  RoutingTable table_;
   std::unordered_map<dpp::snowflake, ptree> guild_to_settings_;
   // TODO: still no guild settings
 
+  // every bind and unbind is appended here, the json file is the snapshot
+  BindingJournal journal_;
+
+  RcuCell<RoutingTable> routes_;
+
 public:
+  using RoutesGuard = RcuCell<RoutingTable>::ReadGuard;
+
   [[nodiscard]] BotSettings();
 
   ~BotSettings();
 
-private:
-  template <typename TData, typename TOther>
-    requires (std::same_as<TData, std::string> && std::same_as<TOther, u64>) ||
-             (std::same_as<TData, u64> && std::same_as<TOther, std::string>)
-  static auto FilterUnwrap(const ptree& value_array, TData data)
+  // The bindings as of now, they stay as they are while the guard is held,
+  // keep it short, no table replaced meanwhile is freed before it goes away
+  [[nodiscard]] auto GetRoutes() const -> RoutesGuard
   {
-    std::string checking_for, other;
-
-    if constexpr (std::same_as<TData, u64>)
-    {
-      checking_for = "channel";
-      other = "client";
-    }
-    else
-    {
-      checking_for = "client";
-      other = "channel";
-    }
-
-    auto data_filter = [checking_for, other, data](auto &pair) {
-      auto result = detail::TreeGetValue<TData>(pair.second, checking_for);
-      if (!result.has_value() || result.value() != data)
-      {
-        return false;
-      }
-      return detail::TreeGetValue<TOther>(pair.second, other).has_value();
-    };
-
-    auto unwrap_transform = [other](auto &pair) {
-      return detail::TreeGetValue<TOther>(pair.second, other).value();
-    };
-
-    namespace stdviews = std::ranges::views;
-    return value_array
-           | stdviews::filter(data_filter)
-           | stdviews::transform(unwrap_transform);
+    return routes_.Read();
   }
 
-public:
-  // Get a view of channels corresponding to the client
-  [[nodiscard]] auto GetChannelList(const std::string &client)
-  {
-    // Why? Why is this a thing? Why do I have to supply the Predicate to get
-    // the iterator type? Now I'm forced to use auto, and exceptions.
-    auto result =
-      detail::TreeGetChild(client_to_channel_, "values");
-
-    return FilterUnwrap<std::string, u64>(result.value(), client);
-  }
+  // Copies of the channels corresponding to the client
+  [[nodiscard]] auto GetChannelList(std::string_view client) const
+    -> std::vector<u64>;
 
   // Gets a list of all Clients bound to a specific Channel
-  [[nodiscard]] auto GetClientList(dpp::snowflake channel)
-  {
-    auto result =
-      detail::TreeGetChild(client_to_channel_, "values");
-
-    // Please give me transform_if :pray:
-    return FilterUnwrap<u64, std::string>(
-      result.value(),
-      static_cast<u64>(channel));
-  }
+  [[nodiscard]] auto GetClientList(dpp::snowflake channel) const
+    -> std::vector<std::string>;
 
-  // Binds a client to a specific channel and flushes the clients
+  // Binds a client to a specific channel and journals the change
   auto BindClient(const std::string &client, dpp::snowflake channel) -> bool;
 
   // Unbinds a client from a channel
@@ -93,53 +156,37 @@ public:
   // Loads guild specific settings
   auto LoadSettings(dpp::snowflake guild) -> bool;
 
-  // Loads all clients bound to any channel
+  // The snapshot of all clients bound to any channel and the journal of the
+  // binds and unbinds since
   static constexpr char
   client_to_channel_file_name[] = "client_to_channel.json";
-  auto LoadClients() -> bool;
+  static constexpr char
+  client_to_channel_journal_name[] = "client_to_channel.journal";
 
 private:
-  // Flushes all the clients to the file
-  void FlushClients();
+  // Loads the snapshot and replays the journal on top of it. Only for the
+  // constructor, nothing reads or writes yet, so it takes no lock and
+  // changes the shards in place
+  auto LoadClients() -> bool;
 
-  // Flushes everything, including guild settings to the appropriate files
-  void FlushAll();
+  // Adds the pair to both indexes, false if it's already there
+  auto InsertBinding(const std::string &client, u64 channel) -> bool;
 
-  // Adds a client to the ptree provided
-  static void PushClient(ptree &value_array, const ptree &obj);
+  // Removes the pair from both indexes, false if it wasn't there
+  auto EraseBinding(const std::string &client, u64 channel) -> bool;
 
-  // Checks whether a pair exists in the ptree provided
-  [[nodiscard]] static auto CheckClientExists(
-    const ptree &value_array,
-    const std::string &client,
-    dpp::snowflake channel) -> bool;
+  // Hands a copy of table_'s shard pointers to the readers, the previous
+  // copy is freed once no reader is left on it
+  void PublishRoutes();
 
-  static auto
-  PairFinder(const std::string& client, dpp::snowflake channel)
-    -> std::function<bool(const ptree::value_type&)>
-  {
-    return
-      [=](const ptree::value_type& element)
-      {
-        global_logger.Debug(
-          "pair_finder()::lambda",
-          "client: {} channel: {}",
-          client,
-          static_cast<u64>(channel));
-
-        auto current_client =
-          detail::TreeGetValue<std::string>(element.second, "client");
-        auto current_channel =
-          detail::TreeGetValue<u64>(element.second, "channel");
-
-        if (current_client.has_value() && current_client.value() == client &&
-            current_channel.has_value() && current_channel.value() == channel)
-        {
-          return true;
-        }
-        return false;
-      };
-  }
+  // Compacts the journal once it grew past JOURNAL_COMPACT_RECORDS
+  void MaybeCompactClients();
+
+  // Hands a snapshot of all the clients over to the journal
+  void CompactClients();
+
+  // Flushes everything, including guild settings to the appropriate files
+  void FlushAll();
 
   // Loads a Tree from a File
   [[nodiscard]] static auto TreeFromFile(const std::string &file_name)
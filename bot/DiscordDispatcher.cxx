@@ -0,0 +1,196 @@
+#include "DiscordDispatcher.hpp"
+
+using namespace bridge;
+
+namespace
+{
+
+auto Backoff(u32 attempts) -> std::chrono::milliseconds
+{
+  const u32 shift = std::min(attempts - 1, 16u);
+  return std::min(
+    DISCORD_RETRY_BACKOFF * (1 << shift),
+    DISCORD_RETRY_BACKOFF_MAX);
+}
+
+} // namespace
+
+DiscordDispatcher::DiscordDispatcher(
+  asio::io_context &io,
+  DiscordGateway &gateway)
+  : strand_(asio::make_strand(io)),
+    gateway_(gateway)
+{
+}
+
+void DiscordDispatcher::Send(u64 channel, std::string content)
+{
+  queue_depth.Set(depth_.fetch_add(1, std::memory_order_relaxed) + 1);
+
+  asio::post(
+    strand_,
+    [this, id = channel, content = std::move(content)]() mutable {
+      auto found = channels_.find(id);
+      if (found == channels_.end())
+      {
+        found = channels_.emplace(
+          id,
+          Channel {{}, asio::steady_timer(strand_)}).first;
+      }
+      Channel &channel = found->second;
+
+      channel.queue.push_back({std::move(content), Clock::now()});
+      // the front may be in flight or retried, it stays, so the queue keeps
+      // at least one message whatever the cap says
+      if (channel.queue.size() > std::max<u32>(DISCORD_QUEUE_MAX, 1))
+      {
+        overflowed.Add();
+        Debug("Send()", "channel: {} full, dropping its oldest", id);
+        Pop(channel, 1);
+      }
+      Pump(id, channel);
+    });
+}
+
+void DiscordDispatcher::Pump(u64 id, Channel &channel)
+{
+  if (channel.in_flight || channel.waiting || channel.queue.empty())
+  {
+    return;
+  }
+
+  const auto now = Clock::now();
+
+  auto ready_at = global_reset_at_;
+  if (channel.remaining == 0)
+  {
+    ready_at = std::max(ready_at, channel.reset_at);
+  }
+  if (ready_at > now)
+  {
+    WaitUntil(id, channel, ready_at);
+    return;
+  }
+
+  // a spent bucket that has reset is unknown again until the answer
+  channel.remaining = channel.remaining > 0 ? channel.remaining - 1 : -1;
+  channel.in_flight = true;
+
+  gateway_.SendMessage(
+    id,
+    channel.queue.front().content,
+    [this, id, start = now](const DiscordResult &result) {
+      asio::post(strand_, [this, id, start, result] {
+        OnResult(id, result, start);
+      });
+    });
+}
+
+void DiscordDispatcher::OnResult(
+  u64 id,
+  const DiscordResult &result,
+  Clock::time_point start)
+{
+  message_create_latency.RecordSince(start);
+
+  Channel &channel = channels_.find(id)->second;
+  channel.in_flight = false;
+
+  const auto now = Clock::now();
+  if (result.remaining >= 0)
+  {
+    channel.remaining = result.remaining;
+    channel.reset_at = now + result.reset_after;
+  }
+
+  Pending &front = channel.queue.front();
+
+  if (!result.IsError())
+  {
+    queue_latency.RecordSince(front.queued, now);
+    Pop(channel);
+    Pump(id, channel);
+    return;
+  }
+
+  if (result.IsRateLimited())
+  {
+    rate_limited.Add();
+
+    const auto retry_after = result.retry_after.count() > 0
+                               ? result.retry_after
+                               : DISCORD_RETRY_AFTER_DEFAULT;
+    Debug(
+      "OnResult()",
+      "channel: {} rate limited for {} ms, global: {}",
+      id,
+      retry_after.count(),
+      result.global);
+
+    if (result.global)
+    {
+      global_reset_at_ = std::max(global_reset_at_, now + retry_after);
+    }
+    else
+    {
+      channel.remaining = 0;
+      channel.reset_at = std::max(channel.reset_at, now + retry_after);
+    }
+
+    Pump(id, channel);
+    return;
+  }
+
+  if (result.IsTransient() && front.attempts < DISCORD_MAX_RETRIES)
+  {
+    ++front.attempts;
+    retries.Add();
+    Debug(
+      "OnResult()",
+      "channel: {} attempt: {} error: {} {}",
+      id,
+      front.attempts,
+      result.status,
+      result.error);
+
+    WaitUntil(id, channel, now + Backoff(front.attempts));
+    return;
+  }
+
+  dropped.Add();
+  Print(
+    "OnResult()",
+    "dropped a message to channel: {} after {} retries, error: {} {}",
+    id,
+    front.attempts,
+    result.status,
+    result.error);
+
+  Pop(channel);
+  Pump(id, channel);
+}
+
+void DiscordDispatcher::WaitUntil(
+  u64 id,
+  Channel &channel,
+  Clock::time_point at)
+{
+  channel.waiting = true;
+  channel.timer.expires_at(at);
+  channel.timer.async_wait([this, id](boost::system::error_code ec) {
+    if (ec)
+    {
+      return;
+    }
+
+    Channel &channel = channels_.find(id)->second;
+    channel.waiting = false;
+    Pump(id, channel);
+  });
+}
+
+void DiscordDispatcher::Pop(Channel &channel, std::size_t index)
+{
+  channel.queue.erase(channel.queue.begin() + static_cast<i64>(index));
+  queue_depth.Set(depth_.fetch_sub(1, std::memory_order_relaxed) - 1);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/Logger.hpp"
+#include "common/Metrics.hpp"
+#include "DiscordGateway.hpp"
+
+#include <deque>
+
+namespace bridge
+{
+
+// the first retry of a failed send waits this long, every next one twice as
+// long up to the cap
+constexpr std::chrono::milliseconds DISCORD_RETRY_BACKOFF {500};
+constexpr std::chrono::milliseconds DISCORD_RETRY_BACKOFF_MAX {30000};
+// a 429 that didn't say how long to wait
+constexpr std::chrono::milliseconds DISCORD_RETRY_AFTER_DEFAULT {1000};
+
+constexpr char DISCORDDISPATCHER_STR[] = "DiscordDispatcher";
+// Sends what goes to Discord as one FIFO per channel with at most one call in
+// flight, so a channel's messages land in order whatever the gateway does
+// internally. The channel's rate limit bucket is tracked from the answers,
+// once it's spent the next send waits for the reset instead of collecting a
+// 429. A 429 that happens anyway is retried after retry_after, errors that
+// never reached Discord and 5xx with backoff up to DISCORD_MAX_RETRIES times,
+// anything else is dropped and logged. A channel holds DISCORD_QUEUE_MAX
+// messages, a full one drops the oldest behind the one up next
+class DiscordDispatcher
+  : private Logger<DISCORDDISPATCHER_STR>
+{
+  using Clock = std::chrono::steady_clock;
+
+  struct Pending
+  {
+    std::string content;
+    Clock::time_point queued;
+    u32 attempts = 0;
+  };
+
+  struct Channel
+  {
+    std::deque<Pending> queue;
+    asio::steady_timer timer;
+    // left in the bucket until reset_at, -1 until Discord tells
+    i32 remaining = -1;
+    Clock::time_point reset_at {};
+    bool in_flight = false;
+    bool waiting = false;
+  };
+
+  asio::strand<asio::io_context::executor_type> strand_;
+  DiscordGateway &gateway_;
+  // only touched on the strand
+  std::unordered_map<u64, Channel> channels_;
+  // set by a global 429, every channel holds until then
+  Clock::time_point global_reset_at_ {};
+  std::atomic<i64> depth_ = 0;
+
+  static inline Gauge queue_depth {
+    "bridge_discord_queue_depth",
+    "Messages waiting to be sent to Discord"};
+  static inline Counter retries {
+    "bridge_discord_retries_total",
+    "Sends to Discord tried again after an error"};
+  static inline Counter rate_limited {
+    "bridge_discord_rate_limited_total",
+    "Sends to Discord answered with a 429"};
+  static inline Counter dropped {
+    "bridge_discord_dropped_total",
+    "Messages given up on after a permanent error or too many retries"};
+  static inline Counter overflowed {
+    "bridge_discord_queue_dropped_total",
+    "Messages dropped because their channel's queue was full"};
+  static inline Histogram message_create_latency {
+    "bridge_discord_message_create_seconds",
+    "Round trip of a message_create to Discord",
+    1'000'000,
+    60'000'000'000,
+    1e-9};
+  static inline Histogram queue_latency {
+    "bridge_discord_queue_seconds",
+    "From being queued to being accepted by Discord",
+    1'000'000,
+    60'000'000'000,
+    1e-9};
+
+public:
+  [[nodiscard]] DiscordDispatcher(
+    asio::io_context &io,
+    DiscordGateway &gateway);
+
+  // Queues a message at the back of the channel's FIFO, may be called from
+  // any thread
+  void Send(u64 channel, std::string content);
+
+  // Messages queued or in flight over every channel
+  [[nodiscard]] auto Depth() const -> i64
+  {
+    return depth_.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Sends the channel's front message if nothing holds it back
+  void Pump(u64 id, Channel &channel);
+
+  void OnResult(u64 id, const DiscordResult &result, Clock::time_point start);
+
+  // Pumps the channel again at the given time
+  void WaitUntil(u64 id, Channel &channel, Clock::time_point at);
+
+  // The front message by default
+  void Pop(Channel &channel, std::size_t index = 0);
+};
+
+} // bridge
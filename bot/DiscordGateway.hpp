@@ -0,0 +1,113 @@
+#pragma once
+
+#include "common/common.hpp"
+
+namespace bridge
+{
+
+// A message posted in a channel the bot can see
+struct DiscordMessage
+{
+  u64 channel;
+  u64 author;
+  std::string author_name;
+  std::string content;
+};
+
+// A slash command someone ran, only string options are passed along
+struct DiscordCommand
+{
+  u64 channel;
+  std::string name;
+  std::unordered_map<std::string, std::string> options;
+  std::function<void(const std::string&)> reply;
+
+  // The option or an empty string if it wasn't given
+  [[nodiscard]] auto Option(const std::string &option) const -> std::string
+  {
+    auto found = options.find(option);
+    return found != options.end() ? found->second : std::string();
+  }
+};
+
+struct DiscordCommandOption
+{
+  std::string name;
+  std::string description;
+  bool required;
+};
+
+struct DiscordCommandSpec
+{
+  std::string name;
+  std::string description;
+  std::vector<DiscordCommandOption> options;
+};
+
+// How a REST call ended, status is the HTTP status, 0 if the call never got
+// an answer. On a 429 retry_after is how long Discord asked to wait, when it
+// said so, and global whether it was the bot wide limit. remaining and
+// reset_after are the route's rate limit bucket after this call, from the
+// X-RateLimit headers, remaining is -1 when they were missing
+struct DiscordResult
+{
+  u16 status;
+  std::string error;
+  std::chrono::milliseconds retry_after {0};
+  i32 remaining = -1;
+  std::chrono::milliseconds reset_after {0};
+  bool global = false;
+
+  [[nodiscard]] auto IsError() const -> bool
+  {
+    return status < 200 || status >= 300;
+  }
+
+  [[nodiscard]] auto IsRateLimited() const -> bool { return status == 429; }
+
+  // Worth trying again as is, Discord didn't refuse the call itself
+  [[nodiscard]] auto IsTransient() const -> bool
+  {
+    return status == 0 || status >= 500;
+  }
+};
+
+// Everything BotChatSession needs from Discord: the events coming in and the
+// REST calls going out. The handlers are set before Start() and may be
+// called from any thread, as are the callbacks of the calls
+class DiscordGateway
+{
+public:
+  using MessageHandler = std::function<void(const DiscordMessage&)>;
+  using CommandHandler = std::function<void(const DiscordCommand&)>;
+  using ReadyHandler = std::function<void()>;
+  using ResultCallback = std::function<void(const DiscordResult&)>;
+
+  virtual ~DiscordGateway() {}
+
+  virtual void OnMessage(MessageHandler &&handler) = 0;
+
+  virtual void OnCommand(CommandHandler &&handler) = 0;
+
+  // May fire again after a reconnect
+  virtual void OnReady(ReadyHandler &&handler) = 0;
+
+  // Connects and returns, the events come in on the gateway's own threads
+  virtual void Start() = 0;
+
+  // The bot's own user id, its messages come back as events as well
+  [[nodiscard]] virtual auto Self() const -> u64 = 0;
+
+  virtual void SendMessage(
+    u64 channel,
+    const std::string &content,
+    ResultCallback &&callback) = 0;
+
+  virtual void RegisterCommand(
+    const DiscordCommandSpec &spec,
+    ResultCallback &&callback) = 0;
+};
+
+using DiscordGatewayPtr = std::unique_ptr<DiscordGateway>;
+
+} // bridge
@@ -0,0 +1,135 @@
+#include "DiscordOutbox.hpp"
+
+using namespace bridge;
+
+namespace
+{
+
+// Where to cut text that's over the limit: after the last line break that
+// fits, or else at the last whole UTF-8 character that does
+auto CutPoint(std::string_view text, std::size_t limit) -> std::size_t
+{
+  const auto line_break = text.rfind('\n', limit - 1);
+  if (line_break != std::string_view::npos && line_break > 0)
+  {
+    return line_break + 1;
+  }
+
+  std::size_t cut = limit;
+  while (cut > 0 && (static_cast<u8>(text[cut]) & 0xC0) == 0x80)
+  {
+    --cut;
+  }
+  return cut > 0 ? cut : limit;
+}
+
+} // namespace
+
+DiscordOutbox::DiscordOutbox(
+  asio::io_context &io,
+  Sink &&sink,
+  std::chrono::milliseconds window,
+  std::size_t limit)
+  : strand_(asio::make_strand(io)),
+    sink_(std::move(sink)),
+    window_(window),
+    limit_(std::max<std::size_t>(limit, 1))
+{
+}
+
+void DiscordOutbox::Post(u64 channel, const ChatMessagePtr &message)
+{
+  asio::post(
+    strand_,
+    RecycledHandler([this, id = channel, message] {
+      auto found = channels_.find(id);
+      if (found == channels_.end())
+      {
+        found = channels_.emplace(
+          id,
+          Channel {{Chunk()}, asio::steady_timer(strand_)}).first;
+      }
+      Channel &channel = found->second;
+
+      Append(channel, message->Markdown());
+
+      // the full chunks don't have to wait for the window
+      while (channel.chunks.size() > 1)
+      {
+        Emit(id, std::move(channel.chunks.front()));
+        channel.chunks.erase(channel.chunks.begin());
+      }
+
+      if (channel.armed)
+      {
+        return;
+      }
+
+      channel.armed = true;
+      channel.timer.expires_after(window_);
+      channel.timer.async_wait([this, id](boost::system::error_code ec) {
+        if (ec)
+        {
+          return;
+        }
+
+        auto found = channels_.find(id);
+        found->second.armed = false;
+        Flush(id, found->second);
+      });
+    }));
+}
+
+void DiscordOutbox::Append(Channel &channel, std::string_view content)
+{
+  Chunk *open = &channel.chunks.back();
+
+  // a line of its own in the open chunk, if it fits
+  if (open->lines > 0 && open->text.size() + 1 + content.size() <= limit_)
+  {
+    open->text.push_back('\n');
+    open->text.append(content);
+    ++open->lines;
+    return;
+  }
+
+  if (open->lines > 0)
+  {
+    open = &channel.chunks.emplace_back();
+  }
+
+  while (content.size() > limit_)
+  {
+    const auto cut = CutPoint(content, limit_);
+    *open = {std::string(content.substr(0, cut)), 1};
+    content.remove_prefix(cut);
+    open = &channel.chunks.emplace_back();
+  }
+
+  *open = {std::string(content), 1};
+}
+
+void DiscordOutbox::Flush(u64 id, Channel &channel)
+{
+  for (auto &chunk : channel.chunks)
+  {
+    if (!chunk.text.empty())
+    {
+      Emit(id, std::move(chunk));
+    }
+  }
+
+  channel.chunks.assign(1, Chunk());
+}
+
+void DiscordOutbox::Emit(u64 id, Chunk &&chunk)
+{
+  Debug(
+    "Emit()",
+    "channel: {} bytes: {} lines: {}",
+    id,
+    chunk.text.size(),
+    chunk.lines);
+  lines_per_send.Record(chunk.lines);
+  sink_(id, std::move(chunk.text));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/ChatMessage.hpp"
+#include "common/Logger.hpp"
+#include "common/Metrics.hpp"
+#include "common/RecyclingPool.hpp"
+
+namespace bridge
+{
+
+// Discord refuses longer messages, counted in characters, bytes are stricter
+constexpr std::size_t DISCORD_MESSAGE_LIMIT = 2000;
+
+constexpr char DISCORDOUTBOX_STR[] = "DiscordOutbox";
+// Coalesces what goes to the same channel within DISCORD_COALESCE_MS into as
+// few Discord messages as fit, one line per message and in order. A message
+// that doesn't fit on its own is split at its line breaks, or wherever it has
+// to be. Full messages leave right away, the rest when the window closes, so
+// the REST calls grow with the channels and not with the messages
+class DiscordOutbox
+  : private Logger<DISCORDOUTBOX_STR>
+{
+public:
+  using Sink = std::function<void(u64 channel, std::string &&content)>;
+
+private:
+  struct Chunk
+  {
+    std::string text;
+    // room messages in it, or parts of them
+    u32 lines = 0;
+  };
+
+  struct Channel
+  {
+    // the last one is still being filled
+    std::vector<Chunk> chunks;
+    asio::steady_timer timer;
+    bool armed = false;
+  };
+
+  asio::strand<asio::io_context::executor_type> strand_;
+  Sink sink_;
+  const std::chrono::milliseconds window_;
+  const std::size_t limit_;
+  // only touched on the strand
+  std::unordered_map<u64, Channel> channels_;
+
+  static inline Histogram lines_per_send {
+    "bridge_discord_coalesced_messages",
+    "Room messages per Discord message sent",
+    1,
+    1 << 10};
+
+public:
+  [[nodiscard]] DiscordOutbox(
+    asio::io_context &io,
+    Sink &&sink,
+    std::chrono::milliseconds window,
+    std::size_t limit = DISCORD_MESSAGE_LIMIT);
+
+  // Queues the Markdown() of a room message for a channel, may be called
+  // from any thread. The message is shared, not copied, and its text is only
+  // read on the strand
+  void Post(u64 channel, const ChatMessagePtr &message);
+
+private:
+  void Append(Channel &channel, std::string_view content);
+
+  // Sends every chunk of the channel, the open one included
+  void Flush(u64 id, Channel &channel);
+
+  void Emit(u64 id, Chunk &&chunk);
+};
+
+} // bridge
@@ -0,0 +1,153 @@
+#include "DppGateway.hpp"
+
+using namespace bridge;
+
+namespace
+{
+
+// Discord's headers count seconds, fractions allowed
+auto Seconds(const std::string &header) -> std::chrono::milliseconds
+{
+  return std::chrono::milliseconds(
+    static_cast<i64>(std::atof(header.c_str()) * 1000));
+}
+
+auto ToResult(const dpp::confirmation_callback_t &result) -> DiscordResult
+{
+  DiscordResult converted {result.http_info.status, {}};
+
+  if (result.is_error())
+  {
+    converted.error = result.get_error().message;
+    // DPP may report errors that never made it to Discord
+    if (!converted.IsError())
+    {
+      converted.status = 0;
+    }
+  }
+
+  const auto &headers = result.http_info.headers;
+
+  // seconds, fractions allowed
+  auto retry_after = headers.find("retry-after");
+  if (retry_after != headers.end())
+  {
+    converted.retry_after = Seconds(retry_after->second);
+  }
+
+  auto remaining = headers.find("x-ratelimit-remaining");
+  auto reset_after = headers.find("x-ratelimit-reset-after");
+  if (remaining != headers.end() && reset_after != headers.end())
+  {
+    converted.remaining = std::atoi(remaining->second.c_str());
+    converted.reset_after = Seconds(reset_after->second);
+  }
+
+  converted.global = headers.contains("x-ratelimit-global");
+
+  return converted;
+}
+
+} // namespace
+
+DppGateway::DppGateway(const std::string &token)
+  : bot_(token, dpp::i_default_intents | dpp::i_message_content)
+{
+}
+
+void DppGateway::OnMessage(MessageHandler &&handler)
+{
+  bot_.on_message_create(
+    [handler = std::move(handler)](const dpp::message_create_t &event) {
+      handler({
+        static_cast<u64>(event.msg.channel_id),
+        static_cast<u64>(event.msg.author.id),
+        event.msg.author.global_name,
+        event.msg.content});
+    });
+}
+
+void DppGateway::OnCommand(CommandHandler &&handler)
+{
+  bot_.on_slashcommand(
+    [this, handler = std::move(handler)](const dpp::slashcommand_t &event) {
+      DiscordCommand command {
+        static_cast<u64>(event.command.channel_id),
+        event.command.get_command_name(),
+        {},
+        [event](const std::string &content) { event.reply(content); }};
+
+      {
+        std::scoped_lock lock(command_options_mutex_);
+        for (const auto &option : command_options_[command.name])
+        {
+          auto value = event.get_parameter(option);
+          if (auto *text = std::get_if<std::string>(&value))
+          {
+            command.options.emplace(option, *text);
+          }
+        }
+      }
+
+      handler(command);
+    });
+}
+
+void DppGateway::OnReady(ReadyHandler &&handler)
+{
+  bot_.on_ready(
+    [handler = std::move(handler)](const dpp::ready_t&) { handler(); });
+}
+
+void DppGateway::Start()
+{
+  bot_.start(dpp::st_return);
+}
+
+auto DppGateway::Self() const -> u64
+{
+  return static_cast<u64>(bot_.me.id);
+}
+
+void DppGateway::SendMessage(
+  u64 channel,
+  const std::string &content,
+  ResultCallback &&callback)
+{
+  bot_.message_create(
+    {channel, content},
+    [callback = std::move(callback)](
+      const dpp::confirmation_callback_t &result) {
+      callback(ToResult(result));
+    });
+}
+
+void DppGateway::RegisterCommand(
+  const DiscordCommandSpec &spec,
+  ResultCallback &&callback)
+{
+  dpp::slashcommand command {spec.name, spec.description, bot_.me.id};
+
+  std::vector<std::string> option_names;
+  for (const auto &option : spec.options)
+  {
+    command.add_option({
+      dpp::co_string,
+      option.name,
+      option.description,
+      option.required});
+    option_names.push_back(option.name);
+  }
+
+  {
+    std::scoped_lock lock(command_options_mutex_);
+    command_options_[spec.name] = std::move(option_names);
+  }
+
+  bot_.global_command_create(
+    command,
+    [callback = std::move(callback)](
+      const dpp::confirmation_callback_t &result) {
+      callback(ToResult(result));
+    });
+}
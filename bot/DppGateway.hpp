@@ -0,0 +1,42 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "DiscordGateway.hpp"
+
+namespace bridge
+{
+
+// The real thing, a dpp::cluster on the bot token
+class DppGateway final
+  : public DiscordGateway
+{
+  dpp::cluster bot_;
+  // the option names of every registered command, DPP only hands them out
+  // one by one
+  std::unordered_map<std::string, std::vector<std::string>> command_options_;
+  std::mutex command_options_mutex_;
+
+public:
+  [[nodiscard]] explicit DppGateway(const std::string &token);
+
+  void OnMessage(MessageHandler &&handler) override;
+
+  void OnCommand(CommandHandler &&handler) override;
+
+  void OnReady(ReadyHandler &&handler) override;
+
+  void Start() override;
+
+  [[nodiscard]] auto Self() const -> u64 override;
+
+  void SendMessage(
+    u64 channel,
+    const std::string &content,
+    ResultCallback &&callback) override;
+
+  void RegisterCommand(
+    const DiscordCommandSpec &spec,
+    ResultCallback &&callback) override;
+};
+
+} // bridge
@@ -0,0 +1,223 @@
+#include "FakeDiscordGateway.hpp"
+
+using namespace bridge;
+
+using boost::asio::co_spawn;
+using boost::asio::detached;
+using boost::asio::use_awaitable;
+using boost::asio::awaitable;
+
+FakeDiscordGateway::FakeDiscordGateway(FakeDiscordOptions options)
+  : options_(std::move(options))
+{
+}
+
+FakeDiscordGateway::~FakeDiscordGateway()
+{
+  Stop();
+}
+
+void FakeDiscordGateway::Stop()
+{
+  io_.stop();
+  if (thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+void FakeDiscordGateway::OnMessage(MessageHandler &&handler)
+{
+  message_handler_ = std::move(handler);
+}
+
+void FakeDiscordGateway::OnCommand(CommandHandler &&handler)
+{
+  command_handler_ = std::move(handler);
+}
+
+void FakeDiscordGateway::OnReady(ReadyHandler &&handler)
+{
+  ready_handler_ = std::move(handler);
+}
+
+void FakeDiscordGateway::Start()
+{
+  asio::post(io_, [this] {
+    if (ready_handler_)
+    {
+      ready_handler_();
+    }
+  });
+
+  if (options_.message_rate > 0 && !options_.channels.empty())
+  {
+    co_spawn(io_, InjectMessages(), detached);
+  }
+
+  thread_ = std::thread([this] {
+    auto work = asio::make_work_guard(io_);
+    io_.run();
+  });
+}
+
+void FakeDiscordGateway::SendMessage(
+  u64 channel,
+  const std::string &content,
+  ResultCallback &&callback)
+{
+  asio::post(
+    io_,
+    [this, channel, content, callback = std::move(callback)]() mutable {
+      const auto now = std::chrono::steady_clock::now();
+
+      Window &window = windows_[channel];
+      if (now - window.start >= options_.rate_limit_window)
+      {
+        window = {now, 0};
+      }
+
+      const auto reset_after = std::chrono::ceil<std::chrono::milliseconds>(
+        window.start + options_.rate_limit_window - now);
+
+      DiscordResult result {200, {}};
+      if (window.sends >= options_.sends_per_window)
+      {
+        result = {429, "You are being rate limited.", reset_after};
+        rate_limited_.fetch_add(1, std::memory_order_relaxed);
+      }
+      else
+      {
+        ++window.sends;
+      }
+
+      // the bucket headers come with every answer
+      result.remaining = options_.sends_per_window - window.sends;
+      result.reset_after = reset_after;
+
+      {
+        std::scoped_lock lock(sent_mutex_);
+        sent_.push_back({channel, std::move(content), now, result.status});
+      }
+
+      Complete(std::move(result), std::move(callback));
+    });
+}
+
+void FakeDiscordGateway::RegisterCommand(
+  const DiscordCommandSpec &spec,
+  ResultCallback &&callback)
+{
+  {
+    std::scoped_lock lock(sent_mutex_);
+    commands_.push_back(spec);
+  }
+
+  asio::post(io_, [this, callback = std::move(callback)]() mutable {
+    Complete({200, {}}, std::move(callback));
+  });
+}
+
+void FakeDiscordGateway::InjectMessage(DiscordMessage &&message)
+{
+  asio::post(io_, [this, message = std::move(message)] {
+    injected_.fetch_add(1, std::memory_order_relaxed);
+    if (message_handler_)
+    {
+      message_handler_(message);
+    }
+  });
+}
+
+void FakeDiscordGateway::InjectCommand(
+  u64 channel,
+  std::string name,
+  std::unordered_map<std::string, std::string> options,
+  std::function<void(const std::string&)> on_reply)
+{
+  DiscordCommand command {
+    channel,
+    std::move(name),
+    std::move(options),
+    [on_reply = std::move(on_reply)](const std::string &content) {
+      if (on_reply)
+      {
+        on_reply(content);
+      }
+    }};
+
+  asio::post(io_, [this, command = std::move(command)] {
+    if (command_handler_)
+    {
+      command_handler_(command);
+    }
+  });
+}
+
+auto FakeDiscordGateway::SentMessages() const -> std::vector<Sent>
+{
+  std::scoped_lock lock(sent_mutex_);
+  return sent_;
+}
+
+auto FakeDiscordGateway::Commands() const -> std::vector<DiscordCommandSpec>
+{
+  std::scoped_lock lock(sent_mutex_);
+  return commands_;
+}
+
+awaitable<void> FakeDiscordGateway::InjectMessages()
+{
+  asio::steady_timer timer(io_);
+  const auto interval =
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1 / options_.message_rate));
+
+  auto next = std::chrono::steady_clock::now();
+  for (u64 i = 0;; ++i)
+  {
+    next += interval;
+    timer.expires_at(next);
+    co_await timer.async_wait(use_awaitable);
+
+    injected_.fetch_add(1, std::memory_order_relaxed);
+    if (message_handler_)
+    {
+      // somebody other than the bot, one author per channel
+      const u64 channel = options_.channels[i % options_.channels.size()];
+      message_handler_({
+        channel,
+        SELF + 1 + i % options_.channels.size(),
+        fmt::format("fake{}", channel),
+        options_.content});
+    }
+  }
+}
+
+void FakeDiscordGateway::Complete(
+  DiscordResult result,
+  ResultCallback &&callback)
+{
+  if (!callback)
+  {
+    return;
+  }
+
+  if (options_.rest_latency.count() == 0)
+  {
+    callback(result);
+    return;
+  }
+
+  auto timer = std::make_shared<asio::steady_timer>(
+    io_,
+    options_.rest_latency);
+  timer->async_wait(
+    [timer, result = std::move(result), callback = std::move(callback)](
+      boost::system::error_code ec) {
+      if (!ec)
+      {
+        callback(result);
+      }
+    });
+}
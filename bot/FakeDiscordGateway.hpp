@@ -0,0 +1,123 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "DiscordGateway.hpp"
+
+#include <mutex>
+
+namespace bridge
+{
+
+struct FakeDiscordOptions
+{
+  // message events injected per second, spread over the channels, 0 for none
+  double message_rate = 0;
+  std::vector<u64> channels = {1};
+  std::string content = "hello from the fake";
+  // how long every REST call takes to complete
+  std::chrono::microseconds rest_latency {0};
+  // a channel takes this many sends per window, the rest get a 429 with the
+  // time left in the window, like Discord's 5 per 5 seconds. Every answer
+  // carries the bucket like the X-RateLimit headers do
+  u32 sends_per_window = 5;
+  std::chrono::milliseconds rate_limit_window {5000};
+};
+
+// In process stand-in for Discord, nothing leaves the process. Injects
+// message events at a fixed rate and whatever InjectMessage() and
+// InjectCommand() are given, records every send and answers them after
+// rest_latency, with a 429 once a channel is over its limit. Everything runs
+// on its own thread, like DPP's
+class FakeDiscordGateway final
+  : public DiscordGateway
+{
+public:
+  struct Sent
+  {
+    u64 channel;
+    std::string content;
+    std::chrono::steady_clock::time_point at;
+    u16 status;
+  };
+
+  static constexpr u64 SELF = 1;
+
+private:
+  struct Window
+  {
+    std::chrono::steady_clock::time_point start;
+    u32 sends = 0;
+  };
+
+  const FakeDiscordOptions options_;
+  asio::io_context io_;
+  std::thread thread_;
+
+  MessageHandler message_handler_;
+  CommandHandler command_handler_;
+  ReadyHandler ready_handler_;
+
+  // only touched on the gateway's thread
+  std::unordered_map<u64, Window> windows_;
+
+  mutable std::mutex sent_mutex_;
+  std::vector<Sent> sent_;
+  std::vector<DiscordCommandSpec> commands_;
+  std::atomic<u64> injected_ = 0;
+  std::atomic<u64> rate_limited_ = 0;
+
+public:
+  [[nodiscard]] explicit FakeDiscordGateway(FakeDiscordOptions options = {});
+
+  ~FakeDiscordGateway();
+
+  void OnMessage(MessageHandler &&handler) override;
+
+  void OnCommand(CommandHandler &&handler) override;
+
+  void OnReady(ReadyHandler &&handler) override;
+
+  void Start() override;
+
+  [[nodiscard]] auto Self() const -> u64 override { return SELF; }
+
+  void SendMessage(
+    u64 channel,
+    const std::string &content,
+    ResultCallback &&callback) override;
+
+  void RegisterCommand(
+    const DiscordCommandSpec &spec,
+    ResultCallback &&callback) override;
+
+  // Delivers a message event on the gateway's thread
+  void InjectMessage(DiscordMessage &&message);
+
+  // Runs a slash command on the gateway's thread, the bot's reply goes to
+  // on_reply
+  void InjectCommand(
+    u64 channel,
+    std::string name,
+    std::unordered_map<std::string, std::string> options,
+    std::function<void(const std::string&)> on_reply = {});
+
+  // Copies of what was sent and registered so far
+  [[nodiscard]] auto SentMessages() const -> std::vector<Sent>;
+
+  [[nodiscard]] auto Commands() const -> std::vector<DiscordCommandSpec>;
+
+  [[nodiscard]] auto Injected() const -> u64 { return injected_; }
+
+  [[nodiscard]] auto RateLimited() const -> u64 { return rate_limited_; }
+
+  // Stops the thread, nothing is delivered or answered after this
+  void Stop();
+
+private:
+  asio::awaitable<void> InjectMessages();
+
+  // Answers a call after rest_latency on the gateway's thread
+  void Complete(DiscordResult result, ResultCallback &&callback);
+};
+
+} // bridge
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "common.hpp"
+#include "FrameDeflate.hpp"
+#include "MessageFormat.hpp"
+#include "WebSocketFrame.hpp"
+
+#include <mutex>
+
+namespace bridge
+{
+
+class ChatMessage;
+
+// Shared between every receiver of a message, never copied while fanning out
+using ChatMessagePtr = std::shared_ptr<const ChatMessage>;
+
+// Immutable refcounted message envelope, it's parsed once when the message
+// enters the ChatRoom and then the same envelope is handed to every
+// participant. The renderings are made the first time someone asks for them
+// and shared from then on, the json one is written to the sockets as is
+class ChatMessage
+{
+  const MessageFormatter::Message envelope_;
+  // when the message entered the bridge, for the delivery latency
+  const std::chrono::steady_clock::time_point created_ =
+    std::chrono::steady_clock::now();
+
+  mutable std::once_flag json_once_;
+  mutable std::string json_;
+  mutable std::once_flag markdown_once_;
+  mutable std::string markdown_;
+  mutable std::once_flag frame_once_;
+  mutable std::string frame_;
+  // one per window size a session can agree on
+  mutable std::array<std::once_flag, DEFLATE_WINDOW_CONFIGS> deflated_once_;
+  mutable std::array<std::string, DEFLATE_WINDOW_CONFIGS> deflated_;
+
+public:
+  // json is the wire form if it's already known, e.g. the text a client sent
+  [[nodiscard]] explicit ChatMessage(
+    MessageFormatter::Message &&envelope,
+    std::string &&json = {})
+    : envelope_(std::move(envelope)), json_(std::move(json)) {}
+
+  ChatMessage(const ChatMessage&) = delete;
+  ChatMessage& operator=(const ChatMessage&) = delete;
+
+  [[nodiscard]] static auto Create(
+    MessageFormatter::Message &&envelope,
+    std::string &&json = {}) -> ChatMessagePtr
+  {
+    return std::make_shared<const ChatMessage>(
+      std::move(envelope),
+      std::move(json));
+  }
+
+  [[nodiscard]] auto Author() const -> const std::string&
+  {
+    return envelope_.author;
+  }
+
+  [[nodiscard]] auto Text() const -> const std::string&
+  {
+    return envelope_.message;
+  }
+
+  [[nodiscard]] auto Client() const -> const std::string&
+  {
+    return envelope_.client;
+  }
+
+  [[nodiscard]] auto Created() const -> std::chrono::steady_clock::time_point
+  {
+    return created_;
+  }
+
+  // The ChatRoom routes on the client the message came from
+  [[nodiscard]] auto Topic() const -> const std::string&
+  {
+    return envelope_.client;
+  }
+
+  // The wire form sent to the websocket clients
+  [[nodiscard]] auto Json() const -> const std::string&
+  {
+    std::call_once(json_once_, [this] {
+      if (json_.empty())
+      {
+        json_ = MessageFormatter::ConstructJson(envelope_);
+      }
+    });
+    return json_;
+  }
+
+  // The line posted to the bound Discord channels
+  [[nodiscard]] auto Markdown() const -> const std::string&
+  {
+    std::call_once(markdown_once_, [this] {
+      markdown_ = MessageFormatter::ConstructMarkdown(envelope_);
+    });
+    return markdown_;
+  }
+
+  // The json as a whole text frame, the same bytes for every client since
+  // server frames aren't masked
+  [[nodiscard]] auto Frame() const -> const std::string&
+  {
+    std::call_once(frame_once_, [this] {
+      frame_ = FrameHeader::Encode(FrameOpcode::text, Json());
+    });
+    return frame_;
+  }
+
+  // The json as a whole frame deflated for the sessions that agreed on
+  // permessage-deflate with window_bits, made by the first of them and shared
+  // by the rest. Empty when compressing doesn't make it smaller
+  [[nodiscard]] auto DeflatedFrame(u8 window_bits) const -> const std::string&
+  {
+    const std::size_t config = window_bits - DEFLATE_MIN_WINDOW_BITS;
+    std::call_once(deflated_once_[config], [this, window_bits, config] {
+      const std::string payload = FrameDeflate::Deflate(Json(), window_bits);
+      if (!payload.empty())
+      {
+        deflated_[config] =
+          FrameHeader::Encode(FrameOpcode::text, payload, true);
+      }
+    });
+    return deflated_[config];
+  }
+
+  [[nodiscard]] auto Buffer() const -> asio::const_buffer
+  {
+    return asio::buffer(Json());
+  }
+
+  [[nodiscard]] auto Size() const -> std::size_t
+  {
+    return Json().size();
+  }
+};
+
+} // bridge
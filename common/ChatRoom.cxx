@@ -5,31 +5,112 @@ using namespace bridge;
 
 void ChatRoom::DeliverMessage(
   const ChatRoomParticipantPtr &participant,
-  const std::string &message)
+  const ChatMessagePtr &message)
 {
-  for (auto& current : participants_)
+  const auto deliver = [&participant, &message](
+    const std::set<ChatRoomParticipantPtr> &receivers)
   {
-    if (current != participant)
+    for (auto& current : receivers)
     {
-      current->DeliverMessage(participant, message);
+      if (current != participant)
+      {
+        current->DeliverMessage(participant, message);
+      }
     }
+  };
+
+  // a participant is either unfiltered or in the subscribers of its topics,
+  // never both, so nobody gets the message twice
+  deliver(unfiltered_);
+
+  auto it = subscribers_.find(message->Topic());
+  if (it != subscribers_.end())
+  {
+    deliver(it->second);
   }
 }
 
 void ChatRoom::Join(const ChatRoomParticipantPtr &participant)
 {
-  participants_.insert(participant);
+  if (participants_.try_emplace(participant).second)
+  {
+    unfiltered_.insert(participant);
+  }
   Debug("Join()", "total: {}", participants_.size());
 }
 
 void ChatRoom::Leave(const ChatRoomParticipantPtr &participant)
 {
-  participants_.erase(participant);
+  auto it = participants_.find(participant);
+  if (it == participants_.end())
+  {
+    return;
+  }
+
+  for (auto& topic : it->second)
+  {
+    auto subscribers = subscribers_.find(topic);
+    subscribers->second.erase(participant);
+    if (subscribers->second.empty())
+    {
+      subscribers_.erase(subscribers);
+    }
+  }
+
+  unfiltered_.erase(participant);
+  participants_.erase(it);
   Debug("Leave()", "total: {}", participants_.size());
 }
 
+void ChatRoom::Subscribe(
+  const ChatRoomParticipantPtr &participant,
+  const std::string &topic)
+{
+  auto it = participants_.find(participant);
+  if (it == participants_.end())
+  {
+    return;
+  }
+
+  if (it->second.empty())
+  {
+    unfiltered_.erase(participant);
+  }
+
+  it->second.insert(topic);
+  subscribers_[topic].insert(participant);
+  Debug("Subscribe()", "topic: {} subscribers: {}",
+    topic, subscribers_[topic].size());
+}
+
+void ChatRoom::Unsubscribe(
+  const ChatRoomParticipantPtr &participant,
+  const std::string &topic)
+{
+  auto it = participants_.find(participant);
+  if (it == participants_.end() || it->second.erase(topic) == 0)
+  {
+    return;
+  }
+
+  auto subscribers = subscribers_.find(topic);
+  subscribers->second.erase(participant);
+  if (subscribers->second.empty())
+  {
+    subscribers_.erase(subscribers);
+  }
+
+  if (it->second.empty())
+  {
+    unfiltered_.insert(participant);
+  }
+  Debug("Unsubscribe()", "topic: {}", topic);
+}
+
 ThreadSafeChatRoom::ThreadSafeChatRoom(asio::io_context &io)
-  : timer_(io)
+  : deliver_messages_(ROOM_QUEUE_CAPACITY),
+    strand_(asio::make_strand(io)),
+    timer_(strand_)
 {
   timer_.expires_at(std::chrono::steady_clock::time_point::max());
 
@@ -45,18 +126,31 @@ awaitable<void> ThreadSafeChatRoom::Delivery()
     {
       Debug("Delivery()", "iteration start");
 
-      std::deque<message_> copied_msgs;
+      // re-arm before draining, anything pushed after the drain rings again;
+      // pairs with the fence in RingDoorbell()
+      doorbell_rung_.store(false, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      // bounded, so a steady stream of producers can't starve the strand
+      const std::size_t max_batch = deliver_messages_.Capacity();
+      std::size_t delivered = 0;
+      queue_depth.Set(deliver_messages_.ApproximateSize());
       {
-        boost::mutex::scoped_lock scoped_lock(mutex_);
-        copied_msgs = deliver_messages_;
-        deliver_messages_.clear();
+        boost::mutex::scoped_lock scoped_lock(participants_mutex_);
+
+        message_ message;
+        while (delivered < max_batch && deliver_messages_.TryPop(message))
+        {
+          DeliverMessageUnsafe(message);
+          ++delivered;
+        }
       }
+      Debug("Delivery()", "delivered: {}", delivered);
+      batch_size.Record(delivered);
 
-      Debug("Delivery()", "copied msgs");
-      while (!copied_msgs.empty())
+      if (delivered == max_batch)
       {
-        DeliverMessageUnsafe(copied_msgs.front());
-        copied_msgs.pop_front();
+        RingDoorbell();
       }
 
       boost::system::error_code ec;
@@ -71,31 +165,60 @@ awaitable<void> ThreadSafeChatRoom::Delivery()
 
 void ThreadSafeChatRoom::DeliverMessage(
   const ChatRoomParticipantPtr &participant,
-  const std::string &message)
+  const ChatMessagePtr &message)
 {
   Debug("DeliverMessageSafe()");
+
+  if (!deliver_messages_.TryPush({participant, message}))
+  {
+    const u64 dropped =
+      dropped_messages_.fetch_add(1, std::memory_order_relaxed) + 1;
+    total_dropped_messages.Add();
+
+    // 1, 2, 4, 8... so a stuck room doesn't flood the log as well
+    if (std::has_single_bit(dropped))
+    {
+      Print("DeliverMessageSafe()", "queue full, dropped: {}", dropped);
+    }
+    return;
+  }
+
+  RingDoorbell();
+}
+
+void ThreadSafeChatRoom::RingDoorbell()
+{
+  // pairs with the fence in Delivery(), either this sees the doorbell
+  // re-armed or the drain sees the message
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (doorbell_rung_.exchange(true, std::memory_order_relaxed))
   {
-    boost::mutex::scoped_lock scoped_lock(mutex_);
-    deliver_messages_.push_back({participant, message});
+    return;
   }
 
-  asio::post(timer_.get_executor(), [self = shared_from_this()] {
+  asio::post(strand_, RecycledHandler([self = shared_from_this()] {
     self->Debug("asio::post");
 
     self->timer_.cancel_one();
-  });
+  }));
   Debug("DeliverMessageSafe()", "posted");
 }
 
 void ThreadSafeChatRoom::DeliverMessageUnsafe(const message_ &message)
 {
+  // framed here once, before any session's strand gets to race for it
+  if (PREFRAMED_BROADCAST)
+  {
+    static_cast<void>(message.content->Frame());
+  }
+
   ChatRoom::DeliverMessage(message.participant, message.content);
 }
 
 void ThreadSafeChatRoom::Join(const ChatRoomParticipantPtr &participant)
 {
   {
-    std::scoped_lock lock(mutex_);
+    std::scoped_lock lock(participants_mutex_);
     ChatRoom::Join(participant);
   }
 }
@@ -103,8 +226,28 @@ void ThreadSafeChatRoom::Join(const ChatRoomParticipantPtr &participant)
 void ThreadSafeChatRoom::Leave(const ChatRoomParticipantPtr &participant)
 {
   {
-    std::scoped_lock lock(mutex_);
+    std::scoped_lock lock(participants_mutex_);
     ChatRoom::Leave(participant);
   }
 }
 
+void ThreadSafeChatRoom::Subscribe(
+  const ChatRoomParticipantPtr &participant,
+  const std::string &topic)
+{
+  {
+    std::scoped_lock lock(participants_mutex_);
+    ChatRoom::Subscribe(participant, topic);
+  }
+}
+
+void ThreadSafeChatRoom::Unsubscribe(
+  const ChatRoomParticipantPtr &participant,
+  const std::string &topic)
+{
+  {
+    std::scoped_lock lock(participants_mutex_);
+    ChatRoom::Unsubscribe(participant, topic);
+  }
+}
+
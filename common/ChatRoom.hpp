@@ -1,7 +1,11 @@
 #pragma once
 
 #include "common.hpp"
+#include "ChatMessage.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
+#include "MpscQueue.hpp"
+#include "RecyclingPool.hpp"
 
 using boost::asio::co_spawn;
 using boost::asio::detached;
@@ -21,7 +25,7 @@ protected:
   friend class ChatRoom;
   virtual void DeliverMessage(
     const std::shared_ptr<ChatRoomParticipant>& participant,
-    const std::string& message) = 0;
+    const ChatMessagePtr& message) = 0;
 };
 
 using ChatRoomParticipantPtr = std::shared_ptr<ChatRoomParticipant>;
@@ -30,18 +34,35 @@ constexpr char CHATROOM_STR[] = "ChatRoom";
 class ChatRoom
   : protected Logger<CHATROOM_STR>
 {
-  std::set<ChatRoomParticipantPtr> participants_;
+  // every participant and the topics it's subscribed to
+  std::map<ChatRoomParticipantPtr, std::set<std::string>> participants_;
+  // participants without a single subscription get every message
+  std::set<ChatRoomParticipantPtr> unfiltered_;
+  // topic -> subscribers, the fan-out only looks at these two
+  std::unordered_map<std::string, std::set<ChatRoomParticipantPtr>>
+    subscribers_;
 
 public:
   virtual void DeliverMessage(
     const ChatRoomParticipantPtr &participant,
-    const std::string &message);
+    const ChatMessagePtr &message);
 
   virtual ~ChatRoom() {}
 
   virtual void Join(const ChatRoomParticipantPtr &participant);
 
   virtual void Leave(const ChatRoomParticipantPtr &participant);
+
+  // From now on the participant only gets messages of the topics it's
+  // subscribed to, topics are the client names of the senders
+  virtual void Subscribe(
+    const ChatRoomParticipantPtr &participant,
+    const std::string &topic);
+
+  // Unsubscribing from the last topic brings back every message
+  virtual void Unsubscribe(
+    const ChatRoomParticipantPtr &participant,
+    const std::string &topic);
 };
 
 class ThreadSafeChatRoom
@@ -51,12 +72,31 @@ class ThreadSafeChatRoom
   struct message_
   {
     ChatRoomParticipantPtr participant;
-    std::string content;
+    ChatMessagePtr content;
   };
 
-  std::deque<message_> deliver_messages_;
+  BoundedMpscQueue<message_> deliver_messages_;
+  // the first producer after a drain rings it, the rest of a burst doesn't
+  std::atomic<bool> doorbell_rung_ = false;
+  std::atomic<u64> dropped_messages_ = 0;
+  // Delivery() and its wake ups never run concurrently, the concrete strand
+  // keeps the allocator of the posted wake ups
+  asio::strand<asio::io_context::executor_type> strand_;
   asio::steady_timer timer_;
-  boost::mutex mutex_;
+  // guards the participants while Delivery() is fanning out
+  boost::mutex participants_mutex_;
+
+  static inline Counter total_dropped_messages {
+    "bridge_room_dropped_messages_total",
+    "Messages dropped because the room's queue was full"};
+  static inline Gauge queue_depth {
+    "bridge_room_queue_depth",
+    "Messages waiting in the room's queue as of the last drain"};
+  static inline Histogram batch_size {
+    "bridge_room_delivery_batch_size",
+    "Messages fanned out per Delivery() drain",
+    1,
+    1 << 16};
 public:
   [[nodiscard]] ThreadSafeChatRoom(asio::io_context &io);
 
@@ -64,19 +104,32 @@ private:
   awaitable<void> Delivery();
 
 public:
-  // Deliver a message from any thread
+  // Deliver a message from any thread, never blocks, the message is dropped
+  // if the queue is full
   void DeliverMessage(
     const ChatRoomParticipantPtr &participant,
-    const std::string &message) override;
+    const ChatMessagePtr &message) override;
 
 private:
-  // Just forwards ThreadSafeChatRoom::message_ to the ChatRoom baseclass
+  // Just forwards ThreadSafeChatRoom::message_ to the ChatRoom baseclass,
+  // participants_mutex_ has to be held
   void DeliverMessageUnsafe(const message_ &message);
 
+  // Wakes up Delivery(), only the first call after a drain posts anything
+  void RingDoorbell();
+
 public:
   void Join(const ChatRoomParticipantPtr &participant) override;
 
   void Leave(const ChatRoomParticipantPtr &participant) override;
+
+  void Subscribe(
+    const ChatRoomParticipantPtr &participant,
+    const std::string &topic) override;
+
+  void Unsubscribe(
+    const ChatRoomParticipantPtr &participant,
+    const std::string &topic) override;
 };
 
 }
@@ -0,0 +1,101 @@
+#include "FrameDeflate.hpp"
+
+#include "boost/beast/zlib/deflate_stream.hpp"
+
+using namespace bridge;
+
+namespace
+{
+
+// what a sync flush always ends with, it's left out of the frame
+constexpr std::array<u8, 4> deflate_tail {0x00, 0x00, 0xff, 0xff};
+
+constexpr i32 deflate_mem_level = 8;
+
+// One stream per window size on each thread, made the first time it's used
+auto StreamFor(u8 window_bits) -> beast::zlib::deflate_stream&
+{
+  thread_local std::array<
+    std::unique_ptr<beast::zlib::deflate_stream>,
+    DEFLATE_WINDOW_CONFIGS> streams;
+
+  auto &stream = streams[window_bits - DEFLATE_MIN_WINDOW_BITS];
+  if (!stream)
+  {
+    stream = std::make_unique<beast::zlib::deflate_stream>();
+    stream->reset(
+      static_cast<i32>(DEFLATE_LEVEL),
+      window_bits,
+      deflate_mem_level,
+      beast::zlib::Strategy::normal);
+  }
+
+  return *stream;
+}
+
+} // namespace
+
+auto FrameDeflate::NegotiatedWindowBits(std::string_view extensions)
+  -> std::optional<u8>
+{
+  if (extensions.find("permessage-deflate") == std::string_view::npos)
+  {
+    return std::nullopt;
+  }
+
+  constexpr std::string_view parameter = "server_max_window_bits=";
+  const std::size_t found = extensions.find(parameter);
+  if (found == std::string_view::npos)
+  {
+    return DEFLATE_MAX_WINDOW_BITS;
+  }
+
+  const u32 bits = std::strtoul(
+    extensions.data() + found + parameter.size(),
+    nullptr,
+    10);
+  return static_cast<u8>(
+    std::clamp<u32>(bits, DEFLATE_MIN_WINDOW_BITS, DEFLATE_MAX_WINDOW_BITS));
+}
+
+auto FrameDeflate::Deflate(std::string_view payload, u8 window_bits)
+  -> std::string
+{
+  auto &stream = StreamFor(window_bits);
+  // a fresh context for every message, the settings stay
+  stream.reset();
+
+  // room for the sync flush on top of the worst case
+  std::string out(stream.upper_bound(payload.size()) + 16, '\0');
+
+  beast::zlib::z_params params;
+  params.next_in = payload.data();
+  params.avail_in = payload.size();
+  params.next_out = out.data();
+  params.avail_out = out.size();
+
+  boost::system::error_code ec;
+  stream.write(params, beast::zlib::Flush::sync, ec);
+  if (ec || params.avail_in != 0)
+  {
+    return {};
+  }
+
+  out.resize(params.total_out);
+  if (out.size() >= deflate_tail.size() &&
+      std::equal(
+        deflate_tail.begin(),
+        deflate_tail.end(),
+        out.end() - deflate_tail.size(),
+        [](u8 tail, char byte) { return tail == static_cast<u8>(byte); }))
+  {
+    out.resize(out.size() - deflate_tail.size());
+  }
+
+  if (out.size() >= payload.size())
+  {
+    return {};
+  }
+
+  return out;
+}
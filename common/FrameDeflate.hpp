@@ -0,0 +1,32 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace bridge
+{
+
+// the window sizes permessage-deflate can agree on, see RFC 7692 section 7.1.2
+inline constexpr u8 DEFLATE_MIN_WINDOW_BITS = 9;
+inline constexpr u8 DEFLATE_MAX_WINDOW_BITS = 15;
+inline constexpr std::size_t DEFLATE_WINDOW_CONFIGS =
+  DEFLATE_MAX_WINDOW_BITS - DEFLATE_MIN_WINDOW_BITS + 1;
+
+// permessage-deflate (RFC 7692) for the frames written next to beast. The
+// server never takes its context over to the next message, so a payload
+// deflates to the same bytes for every session with the same window and the
+// result can be shared between them
+class FrameDeflate
+{
+public:
+  // The server_max_window_bits agreed on in the Sec-WebSocket-Extensions of
+  // a handshake response, nullopt if permessage-deflate wasn't agreed on
+  [[nodiscard]] static auto NegotiatedWindowBits(std::string_view extensions)
+    -> std::optional<u8>;
+
+  // The payload of a compressed frame at DEFLATE_LEVEL, on a stream reused by
+  // the calling thread. Empty when it wouldn't make the payload smaller
+  [[nodiscard]] static auto Deflate(std::string_view payload, u8 window_bits)
+    -> std::string;
+};
+
+} // bridge
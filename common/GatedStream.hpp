@@ -0,0 +1,186 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace bridge
+{
+
+// Next layer of a websocket stream that lets whole frames be written straight
+// to the socket next to beast. Every write, whether it comes from beast
+// (handshake, pong, close) or from the owner, is written out completely while
+// holding the gate, so frames never interleave on the wire. The owner writes
+// through async_write_frames(), which stops going out once the stream is
+// sealed, so nothing follows beast's close frame.
+// Must be used from a single strand.
+template <typename NextLayer>
+class GatedStream
+{
+public:
+  using next_layer_type = NextLayer;
+  using executor_type = typename NextLayer::executor_type;
+
+private:
+  NextLayer next_layer_;
+  // the same cancel trick as everywhere else, waiters wake up on release
+  asio::steady_timer gate_timer_;
+  bool writing_ = false;
+  bool sealed_ = false;
+
+  // owned writes come from async_write_frames() and are refused once sealed
+  template <typename ConstBufferSequence, bool owned>
+  struct WriteOp : asio::coroutine
+  {
+    GatedStream &stream;
+    ConstBufferSequence buffers;
+
+    template <typename Self>
+    void operator()(
+      Self &self,
+      boost::system::error_code ec = {},
+      std::size_t bytes_transferred = 0)
+    {
+      BOOST_ASIO_CORO_REENTER(*this)
+      {
+        while (stream.writing_)
+        {
+          BOOST_ASIO_CORO_YIELD
+            stream.gate_timer_.async_wait(std::move(self));
+        }
+
+        if (owned && stream.sealed_)
+        {
+          // never complete from within the initiation
+          BOOST_ASIO_CORO_YIELD
+            asio::post(stream.get_executor(), std::move(self));
+          self.complete(asio::error::operation_aborted, 0);
+          return;
+        }
+
+        stream.writing_ = true;
+        BOOST_ASIO_CORO_YIELD
+          asio::async_write(stream.next_layer_, buffers, std::move(self));
+
+        stream.writing_ = false;
+        stream.gate_timer_.cancel();
+        self.complete(ec, bytes_transferred);
+      }
+    }
+  };
+
+public:
+  template <typename... Args>
+  [[nodiscard]] explicit GatedStream(Args&&... args)
+    : next_layer_(std::forward<Args>(args)...),
+      gate_timer_(next_layer_.get_executor())
+  {
+    gate_timer_.expires_at(std::chrono::steady_clock::time_point::max());
+  }
+
+  auto get_executor() noexcept -> executor_type
+  {
+    return next_layer_.get_executor();
+  }
+
+  auto next_layer() noexcept -> next_layer_type&
+  {
+    return next_layer_;
+  }
+
+  auto next_layer() const noexcept -> const next_layer_type&
+  {
+    return next_layer_;
+  }
+
+  template <typename MutableBufferSequence, typename ReadToken>
+  auto async_read_some(const MutableBufferSequence &buffers, ReadToken &&token)
+  {
+    return next_layer_.async_read_some(buffers, std::forward<ReadToken>(token));
+  }
+
+  // Unlike a plain socket this always writes the whole sequence, once the
+  // gate is free
+  template <typename ConstBufferSequence, typename WriteToken>
+  auto async_write_some(
+    const ConstBufferSequence &buffers,
+    WriteToken &&token)
+  {
+    return asio::async_compose<
+      WriteToken,
+      void(boost::system::error_code, std::size_t)>(
+        WriteOp<ConstBufferSequence, false> {{}, *this, buffers},
+        token,
+        next_layer_);
+  }
+
+  // Whole frames of the owner, fails with operation_aborted once sealed,
+  // also when it was already waiting for the gate
+  template <typename ConstBufferSequence, typename WriteToken>
+  auto async_write_frames(
+    const ConstBufferSequence &buffers,
+    WriteToken &&token)
+  {
+    return asio::async_compose<
+      WriteToken,
+      void(boost::system::error_code, std::size_t)>(
+        WriteOp<ConstBufferSequence, true> {{}, *this, buffers},
+        token,
+        next_layer_);
+  }
+
+  // From now on only beast writes, called before closing
+  void Seal() { sealed_ = true; }
+
+  template <typename MutableBufferSequence>
+  auto read_some(const MutableBufferSequence &buffers) -> std::size_t
+  {
+    return next_layer_.read_some(buffers);
+  }
+
+  template <typename MutableBufferSequence>
+  auto read_some(
+    const MutableBufferSequence &buffers,
+    boost::system::error_code &ec) -> std::size_t
+  {
+    return next_layer_.read_some(buffers, ec);
+  }
+
+  template <typename ConstBufferSequence>
+  auto write_some(const ConstBufferSequence &buffers) -> std::size_t
+  {
+    return asio::write(next_layer_, buffers);
+  }
+
+  template <typename ConstBufferSequence>
+  auto write_some(
+    const ConstBufferSequence &buffers,
+    boost::system::error_code &ec) -> std::size_t
+  {
+    return asio::write(next_layer_, buffers, ec);
+  }
+};
+
+// beast finds these through ADL when closing the websocket
+template <typename NextLayer>
+void teardown(
+  beast::role_type role,
+  GatedStream<NextLayer> &stream,
+  boost::system::error_code &ec)
+{
+  using beast::websocket::teardown;
+  teardown(role, stream.next_layer(), ec);
+}
+
+template <typename NextLayer, typename TeardownHandler>
+void async_teardown(
+  beast::role_type role,
+  GatedStream<NextLayer> &stream,
+  TeardownHandler &&handler)
+{
+  using beast::websocket::async_teardown;
+  async_teardown(
+    role,
+    stream.next_layer(),
+    std::forward<TeardownHandler>(handler));
+}
+
+} // bridge
@@ -0,0 +1,98 @@
+#include "IoContextPool.hpp"
+
+using namespace bridge;
+
+IoContextPool::IoContextPool(u32 context_count, u32 thread_count)
+  : thread_count_(std::max({thread_count, context_count, 1u}))
+{
+  context_count = std::max(context_count, 1u);
+  Debug(
+    "Constructor",
+    "contexts: {} threads: {}",
+    context_count,
+    thread_count_);
+
+  for (u32 i = 0; i < context_count; ++i)
+  {
+    // threads i, i + context_count, ... run context i
+    const u32 threads_on_context =
+      thread_count_ / context_count + (i < thread_count_ % context_count);
+
+    auto &context = contexts_.emplace_back(
+      std::make_unique<asio::io_context>(
+        static_cast<int>(threads_on_context)));
+
+    work_guards_.emplace_back(asio::make_work_guard(*context));
+  }
+}
+
+IoContextPool::~IoContextPool()
+{
+  Stop();
+  for (auto &thread : threads_)
+  {
+    if (thread.joinable())
+    {
+      thread.join();
+    }
+  }
+}
+
+auto IoContextPool::GetNextContext() -> asio::io_context&
+{
+  const std::size_t index =
+    next_context_.fetch_add(1, std::memory_order_relaxed) % contexts_.size();
+
+  return *contexts_[index];
+}
+
+auto IoContextPool::GetContext(std::size_t index) -> asio::io_context&
+{
+  return *contexts_.at(index);
+}
+
+auto IoContextPool::Size() const -> std::size_t
+{
+  return contexts_.size();
+}
+
+void IoContextPool::Run()
+{
+  Debug("Run()");
+
+  for (u32 i = 0; i < thread_count_; ++i)
+  {
+    threads_.emplace_back([this, &context = *contexts_[i % contexts_.size()]] {
+      while (true)
+      {
+        try
+        {
+          context.run();
+          return;
+        }
+        catch (std::exception &e)
+        {
+          // a throwing handler must not take the whole worker down
+          Debug("Run()::worker", "caught: {}", e.what());
+        }
+      }
+    });
+  }
+  Debug("Run()", "started {} workers", threads_.size());
+
+  for (auto &thread : threads_)
+  {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+void IoContextPool::Stop()
+{
+  Debug("Stop()");
+
+  for (auto &guard : work_guards_)
+  {
+    guard.reset();
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "common.hpp"
+#include "Logger.hpp"
+
+namespace bridge
+{
+
+constexpr char IOCONTEXTPOOL_STR[] = "IoContextPool";
+class IoContextPool
+  : private Logger<IOCONTEXTPOOL_STR>
+{
+  using WorkGuard = asio::executor_work_guard<asio::io_context::executor_type>;
+
+  std::vector<std::unique_ptr<asio::io_context>> contexts_;
+  std::vector<WorkGuard> work_guards_;
+  std::vector<std::thread> threads_;
+  std::atomic<std::size_t> next_context_ = 0;
+  u32 thread_count_;
+public:
+  // thread_count threads are spread evenly over context_count io_contexts,
+  // each context is told how many threads are going to run it
+  [[nodiscard]] IoContextPool(u32 context_count, u32 thread_count);
+
+  ~IoContextPool();
+
+  IoContextPool(const IoContextPool&) = delete;
+  IoContextPool& operator=(const IoContextPool&) = delete;
+
+  // Round robin over the contexts, used to spread sessions over the pool
+  [[nodiscard]] auto GetNextContext() -> asio::io_context&;
+
+  [[nodiscard]] auto GetContext(std::size_t index) -> asio::io_context&;
+
+  [[nodiscard]] auto Size() const -> std::size_t;
+
+  // Runs all the contexts and blocks until every worker has returned
+  void Run();
+
+  // Lets the workers return once they run out of work
+  void Stop();
+};
+
+} // bridge
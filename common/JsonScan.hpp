@@ -0,0 +1,103 @@
+#pragma once
+
+#include "common.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace bridge
+{
+namespace detail
+{
+
+// '"', '\\' and control characters are the only bytes that end a plain run
+// inside a JSON string, both when parsing and when escaping
+[[nodiscard]] inline auto IsJsonSpecial(char c) -> bool
+{
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+// Returns the index of the first special byte at or after offset, or the
+// size of data if there's none, 16 bytes at a time where SIMD is available
+[[nodiscard]] inline auto FindJsonSpecial(
+  std::string_view data,
+  std::size_t offset = 0) -> std::size_t
+{
+  const char *begin = data.data();
+  std::size_t i = offset;
+
+  // escapes tend to come in runs, a plain look at the first byte keeps those
+  // off the latency of the vector compare
+  if (i < data.size() && IsJsonSpecial(begin[i]))
+  {
+    return i;
+  }
+
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+
+  for (; i + 16 <= data.size(); i += 16)
+  {
+    const __m128i chunk =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + i));
+
+    // unsigned min(chunk, 0x1F) == chunk is chunk <= 0x1F
+    const __m128i special = _mm_or_si128(
+      _mm_or_si128(
+        _mm_cmpeq_epi8(chunk, quote),
+        _mm_cmpeq_epi8(chunk, backslash)),
+      _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+
+    if (const u32 mask = _mm_movemask_epi8(special); mask != 0)
+    {
+      return i + std::countr_zero(mask);
+    }
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  const uint8x16_t control = vdupq_n_u8(0x1F);
+
+  for (; i + 16 <= data.size(); i += 16)
+  {
+    const uint8x16_t chunk =
+      vld1q_u8(reinterpret_cast<const uint8_t*>(begin + i));
+
+    const uint8x16_t special = vorrq_u8(
+      vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+      vcleq_u8(chunk, control));
+
+    // no movemask on NEON, the scalar loop below pins it down
+#if defined(__aarch64__)
+    if (vmaxvq_u8(special) != 0)
+#else
+    // ARMv7 has no across vector max, a pairwise one folds the 16 lanes
+    // into 8
+    const uint8x8_t folded =
+      vpmax_u8(vget_low_u8(special), vget_high_u8(special));
+    if (vget_lane_u64(vreinterpret_u64_u8(folded), 0) != 0)
+#endif
+    {
+      break;
+    }
+  }
+#endif
+
+  for (; i < data.size(); ++i)
+  {
+    if (IsJsonSpecial(begin[i]))
+    {
+      return i;
+    }
+  }
+
+  return data.size();
+}
+
+} // detail
+} // bridge
@@ -0,0 +1,144 @@
+#include "LogLevel.hpp"
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+using namespace bridge;
+
+namespace
+{
+
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<std::pair<std::string_view, std::atomic<LogLevel>*>> domains;
+  // everything applied so far, replayed for domains registered later
+  std::vector<std::pair<std::string, LogLevel>> applied;
+};
+
+auto GetRegistry() -> Registry&
+{
+  // loggers register during static initialization, in no particular order
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+auto ParseLevel(std::string_view name) -> std::optional<LogLevel>
+{
+  if (name == "debug")
+  {
+    return LogLevel::debug;
+  }
+  if (name == "log")
+  {
+    return LogLevel::log;
+  }
+  if (name == "off")
+  {
+    return LogLevel::off;
+  }
+  return std::nullopt;
+}
+
+auto Trim(std::string_view value) -> std::string_view
+{
+  constexpr std::string_view whitespace = " \t\r\n";
+
+  const std::size_t begin = value.find_first_not_of(whitespace);
+  if (begin == std::string_view::npos)
+  {
+    return {};
+  }
+  return value.substr(begin, value.find_last_not_of(whitespace) - begin + 1);
+}
+
+} // namespace
+
+void LogLevels::Register(std::string_view domain, std::atomic<LogLevel> &level)
+{
+  Registry &registry = GetRegistry();
+  std::scoped_lock lock(registry.mutex);
+
+  registry.domains.emplace_back(domain, &level);
+  for (const auto &[name, applied] : registry.applied)
+  {
+    if (name == "*" || name == domain)
+    {
+      level.store(applied, std::memory_order_relaxed);
+    }
+  }
+}
+
+auto LogLevels::Apply(std::string_view spec) -> bool
+{
+  Registry &registry = GetRegistry();
+  std::scoped_lock lock(registry.mutex);
+
+  bool parsed = true;
+  while (!spec.empty())
+  {
+    const std::size_t end = spec.find_first_of(",\n");
+    const std::string_view entry = Trim(spec.substr(0, end));
+    spec.remove_prefix(end == std::string_view::npos ? spec.size() : end + 1);
+
+    if (entry.empty() || entry.front() == '#')
+    {
+      continue;
+    }
+
+    const std::size_t equals = entry.find('=');
+    const std::string_view name = Trim(entry.substr(0, equals));
+    const std::optional<LogLevel> level = equals == std::string_view::npos
+      ? std::nullopt
+      : ParseLevel(Trim(entry.substr(equals + 1)));
+
+    if (name.empty() || !level.has_value())
+    {
+      parsed = false;
+      continue;
+    }
+
+    // whatever came before is overridden, no need to replay it any more
+    std::erase_if(registry.applied, [name](const auto &applied) {
+      return name == "*" || applied.first == name;
+    });
+    registry.applied.emplace_back(name, *level);
+
+    for (const auto &[domain, domain_level] : registry.domains)
+    {
+      if (name == "*" || name == domain)
+      {
+        domain_level->store(*level, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  return parsed;
+}
+
+auto LogLevels::Load() -> bool
+{
+  bool loaded = true;
+
+  if (const char *spec = std::getenv("BRIDGE_LOG_LEVELS"); spec != nullptr)
+  {
+    loaded = Apply(spec);
+  }
+
+  const char *file_name = std::getenv("BRIDGE_LOG_LEVELS_FILE");
+  if (file_name == nullptr || *file_name == '\0')
+  {
+    return loaded;
+  }
+
+  std::ifstream file(file_name);
+  if (!file)
+  {
+    return false;
+  }
+
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return Apply(contents.str()) && loaded;
+}
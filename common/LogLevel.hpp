@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace bridge
+{
+
+// Per Logger domain: debug lets everything through, log only Print, off
+// nothing at all
+enum class LogLevel : u8
+{
+  debug,
+  log,
+  off
+};
+
+// Where every domain starts before BRIDGE_LOG_LEVELS or a reload says
+// otherwise
+#ifdef NDEBUG
+inline constexpr LogLevel DEFAULT_LOG_LEVEL = LogLevel::log;
+#else
+inline constexpr LogLevel DEFAULT_LOG_LEVEL = LogLevel::debug;
+#endif // NDEBUG
+
+// The current_domain of a log line. Only constants convert to it, so a record
+// can keep the view until the LogSink thread gets to it instead of a copy
+class LogScope
+{
+  std::string_view value_;
+
+public:
+  consteval LogScope(const char *value)
+    : value_(value)
+  {
+  }
+
+  consteval LogScope(std::string_view value)
+    : value_(value)
+  {
+  }
+
+  [[nodiscard]] constexpr auto View() const -> std::string_view
+  {
+    return value_;
+  }
+};
+
+// Names every Logger<domain> level so they can be changed at runtime, from
+// BRIDGE_LOG_LEVELS at startup and from BRIDGE_LOG_LEVELS_FILE on SIGHUP
+class LogLevels
+{
+public:
+  // Once per Logger<domain>, picks up whatever was applied for it already
+  static void Register(std::string_view domain, std::atomic<LogLevel> &level);
+
+  // "domain=level,..." with * for every domain, later entries win and the
+  // domains left out keep their level. Returns false if any entry didn't
+  // parse, the ones that did are still applied
+  static auto Apply(std::string_view spec) -> bool;
+
+  // Applies BRIDGE_LOG_LEVELS and then the contents of BRIDGE_LOG_LEVELS_FILE,
+  // one entry per line works there too. False if either didn't fully parse or
+  // the file couldn't be read
+  static auto Load() -> bool;
+};
+
+} // bridge
@@ -0,0 +1,199 @@
+#include "LogSink.hpp"
+
+#include <cstdio>
+
+using namespace bridge;
+using namespace bridge::detail;
+
+namespace
+{
+
+// drop or block, anything else is drop
+auto GetLogOverflowPolicy() -> LogOverflowPolicy
+{
+  const char* value = std::getenv("BRIDGE_LOG_OVERFLOW");
+  const std::string_view policy = value == nullptr ? "" : value;
+
+  return policy == "block" ? LogOverflowPolicy::block : LogOverflowPolicy::drop;
+}
+
+// Lets the sink know once the owning thread is gone
+struct LocalRingHolder
+{
+  std::shared_ptr<LogRing> ring;
+
+  ~LocalRingHolder()
+  {
+    if (ring)
+    {
+      ring->abandoned.store(true, std::memory_order_release);
+    }
+  }
+};
+
+} // namespace
+
+LogRing::LogRing(std::size_t capacity)
+  : buffer_(new std::byte[capacity]),
+    capacity_(capacity)
+{
+}
+
+auto LogRing::Drain(fmt::memory_buffer &out) -> std::size_t
+{
+  u64 head = head_.load(std::memory_order_relaxed);
+  const u64 tail = tail_.load(std::memory_order_acquire);
+
+  std::size_t records = 0;
+  while (head != tail)
+  {
+    std::byte *record = buffer_.get() + head % capacity_;
+    auto *header = std::launder(reinterpret_cast<LogRecordHeader*>(record));
+
+    if (header->consume != nullptr)
+    {
+      header->consume(record + sizeof(LogRecordHeader), out);
+      ++records;
+    }
+
+    head += header->size;
+  }
+
+  head_.store(head, std::memory_order_release);
+  return records;
+}
+
+LogSink::LogSink()
+  // rounded up so the records, 16 bytes each at least, tile the ring
+  : ring_capacity_(
+      (std::max<std::size_t>(
+         4096,
+         GetEnvOr<std::size_t>("BRIDGE_LOG_RING_BYTES", 256 << 10)) + 15) &
+      ~std::size_t {15}),
+    overflow_policy_(GetLogOverflowPolicy())
+{
+  writer_ = std::thread([this] { Writer(); });
+  std::atexit([] { Instance().Flush(); });
+}
+
+auto LogSink::Instance() -> LogSink&
+{
+  static LogSink *sink = new LogSink();
+  return *sink;
+}
+
+void LogSink::Flush()
+{
+  if (stopping_.exchange(true))
+  {
+    return;
+  }
+
+  doorbell_.fetch_add(1, std::memory_order_release);
+  doorbell_.notify_one();
+  writer_.join();
+
+  // whatever made it in after the writer's last look
+  stopped_.store(true, std::memory_order_release);
+  fmt::memory_buffer out;
+  DrainAll(out);
+  WriteLocked(out);
+}
+
+auto LogSink::LocalRing() -> LogRing&
+{
+  thread_local LocalRingHolder holder;
+
+  if (!holder.ring)
+  {
+    holder.ring = std::make_shared<LogRing>(ring_capacity_);
+
+    std::scoped_lock lock(mutex_);
+    rings_.push_back(holder.ring);
+  }
+
+  return *holder.ring;
+}
+
+void LogSink::RingDoorbell()
+{
+  // pairs with the fence in Writer(), either this sees it going to sleep or
+  // its last look sees the record
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!sleeping_.load(std::memory_order_relaxed) ||
+      !sleeping_.exchange(false, std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  doorbell_.fetch_add(1, std::memory_order_release);
+  doorbell_.notify_one();
+}
+
+void LogSink::Writer()
+{
+  fmt::memory_buffer out;
+
+  while (!stopping_.load(std::memory_order_acquire))
+  {
+    if (DrainAll(out) != 0)
+    {
+      WriteLocked(out);
+      out.clear();
+      continue;
+    }
+
+    const u32 doorbell = doorbell_.load(std::memory_order_acquire);
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (DrainAll(out) == 0 && !stopping_.load(std::memory_order_acquire))
+    {
+      doorbell_.wait(doorbell, std::memory_order_acquire);
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
+
+    WriteLocked(out);
+    out.clear();
+  }
+
+  DrainAll(out);
+  WriteLocked(out);
+}
+
+auto LogSink::DrainAll(fmt::memory_buffer &out) -> std::size_t
+{
+  std::scoped_lock lock(mutex_);
+
+  std::size_t records = 0;
+  std::erase_if(rings_, [&out, &records](const auto &ring) {
+    // read first, everything the thread pushed is visible after that
+    const bool abandoned = ring->abandoned.load(std::memory_order_acquire);
+    records += ring->Drain(out);
+
+    if (const u64 dropped = ring->dropped.exchange(0); dropped != 0)
+    {
+      fmt::format_to(
+        std::back_inserter(out),
+        "[LOG - LogSink::DrainAll()] ring full, dropped: {}\n",
+        dropped);
+      ++records;
+    }
+
+    return abandoned;
+  });
+
+  return records;
+}
+
+void LogSink::WriteLocked(const fmt::memory_buffer &out)
+{
+  if (out.size() == 0)
+  {
+    return;
+  }
+
+  std::scoped_lock lock(mutex_);
+  std::fwrite(out.data(), 1, out.size(), stdout);
+  std::fflush(stdout);
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <mutex>
+
+namespace bridge
+{
+
+// What a thread does when its log ring is full
+enum class LogOverflowPolicy : u8
+{
+  drop,
+  block
+};
+
+namespace detail
+{
+
+// What a record keeps of an argument. The record is formatted later on
+// another thread, so anything that only points at characters is copied.
+template <typename T>
+using LogArg = std::conditional_t<
+  std::is_convertible_v<const std::decay_t<T>&, std::string_view>,
+  std::string,
+  std::decay_t<T>>;
+
+// Fixed size header in front of every record in a LogRing, consume formats
+// the payload behind it into out and destroys it, nullptr marks the padding
+// left at the end of the ring when a record didn't fit there
+struct alignas(16) LogRecordHeader
+{
+  u32 size;
+  void (*consume)(void *payload, fmt::memory_buffer &out);
+};
+
+// Single producer single consumer ring of variable sized records, the
+// producer is the thread owning it, the consumer is the LogSink thread
+class LogRing
+{
+  std::unique_ptr<std::byte[]> buffer_;
+  const std::size_t capacity_;
+
+  alignas(64) std::atomic<u64> head_ = 0;
+  alignas(64) std::atomic<u64> tail_ = 0;
+
+public:
+  // set once the owning thread is gone, the ring is dropped after a drain
+  std::atomic<bool> abandoned = false;
+  std::atomic<u64> dropped = 0;
+
+  explicit LogRing(std::size_t capacity);
+
+  // Header plus payload, rounded up so every record stays aligned
+  template <typename Payload>
+  [[nodiscard]] static constexpr auto RecordSize() -> std::size_t
+  {
+    return (sizeof(LogRecordHeader) + sizeof(Payload) + 15) &
+           ~std::size_t {15};
+  }
+
+  // Constructs the payload in place, false when there's no room for it
+  template <typename Payload, typename... Args>
+  [[nodiscard]] auto TryPush(Args&&... args) -> bool
+  {
+    static_assert(alignof(Payload) <= alignof(LogRecordHeader));
+    constexpr std::size_t size = RecordSize<Payload>();
+
+    const u64 tail = tail_.load(std::memory_order_relaxed);
+    const u64 head = head_.load(std::memory_order_acquire);
+
+    const std::size_t position = tail % capacity_;
+    const std::size_t to_end = capacity_ - position;
+    // a record never wraps, the rest of the ring is padded out instead
+    const std::size_t padding = to_end < size ? to_end : 0;
+
+    if (capacity_ - (tail - head) < size + padding)
+    {
+      return false;
+    }
+
+    if (padding != 0)
+    {
+      new (buffer_.get() + position) LogRecordHeader {
+        static_cast<u32>(padding),
+        nullptr};
+    }
+
+    std::byte *record = buffer_.get() + (tail + padding) % capacity_;
+    new (record) LogRecordHeader {static_cast<u32>(size), &Payload::Consume};
+    new (record + sizeof(LogRecordHeader)) Payload {
+      std::forward<Args>(args)...};
+
+    tail_.store(tail + padding + size, std::memory_order_release);
+    return true;
+  }
+
+  // Formats every record that's ready into out, returns how many there were
+  auto Drain(fmt::memory_buffer &out) -> std::size_t;
+
+  [[nodiscard]] auto Capacity() const -> std::size_t { return capacity_; }
+};
+
+// A formatted later log line, the format string was already checked at the
+// call site and the arguments are held by value
+template <typename... T>
+struct LogPayload
+{
+  std::string_view print_type;
+  const char *domain;
+  // a LogScope, constant
+  std::string_view current_domain;
+  std::optional<fmt::string_view> format;
+  std::tuple<LogArg<T>...> args;
+
+  void Format(fmt::memory_buffer &out) const
+  {
+    fmt::format_to(
+      std::back_inserter(out),
+      "[{} - {}::{}]",
+      print_type,
+      domain,
+      current_domain);
+
+    if (format.has_value())
+    {
+      out.push_back(' ');
+      std::apply(
+        [this, &out](const auto&... values) {
+          fmt::vformat_to(
+            std::back_inserter(out),
+            *format,
+            fmt::make_format_args(values...));
+        },
+        args);
+    }
+
+    out.push_back('\n');
+  }
+
+  static void Consume(void *payload, fmt::memory_buffer &out)
+  {
+    auto *self = static_cast<LogPayload*>(payload);
+
+    self->Format(out);
+    self->~LogPayload();
+  }
+};
+
+} // detail
+
+// Takes log records from any thread without locking, each thread gets its own
+// ring on its first record. A background thread formats and writes them to
+// stdout, what's left is flushed at exit and later records are written
+// straight away.
+//
+// BRIDGE_LOG_RING_BYTES sizes the rings, BRIDGE_LOG_OVERFLOW is drop or block
+class LogSink
+{
+  const std::size_t ring_capacity_;
+  const LogOverflowPolicy overflow_policy_;
+
+  // guards rings_ and the writes once the thread is stopped
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<detail::LogRing>> rings_;
+
+  std::atomic<u32> doorbell_ = 0;
+  std::atomic<bool> sleeping_ = false;
+  std::atomic<bool> stopping_ = false;
+  std::atomic<bool> stopped_ = false;
+  std::thread writer_;
+
+  LogSink();
+
+public:
+  LogSink(const LogSink&) = delete;
+  LogSink& operator=(const LogSink&) = delete;
+
+  // Never destroyed, records can come in until the very end
+  [[nodiscard]] static auto Instance() -> LogSink&;
+
+  template <typename... T>
+  void Push(
+    std::string_view print_type,
+    const char *domain,
+    std::string_view current_domain,
+    std::optional<fmt::string_view> format,
+    T&&... args)
+  {
+    using Payload = detail::LogPayload<T...>;
+
+    // the only copy of the arguments, moved into the ring once there's room
+    std::tuple<detail::LogArg<T>...> values(std::forward<T>(args)...);
+
+    if (stopped_.load(std::memory_order_acquire))
+    {
+      fmt::memory_buffer out;
+      const Payload payload {
+        print_type,
+        domain,
+        current_domain,
+        format,
+        std::move(values)};
+      payload.Format(out);
+      WriteLocked(out);
+      return;
+    }
+
+    detail::LogRing &ring = LocalRing();
+    while (!ring.TryPush<Payload>(
+      print_type,
+      domain,
+      current_domain,
+      format,
+      std::move(values)))
+    {
+      // past half the ring the padding at the end may never leave room
+      if (overflow_policy_ == LogOverflowPolicy::drop ||
+          2 * detail::LogRing::RecordSize<Payload>() > ring.Capacity())
+      {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+
+      RingDoorbell();
+      std::this_thread::yield();
+    }
+
+    RingDoorbell();
+  }
+
+  // Stops the background thread and writes out whatever is left
+  void Flush();
+
+private:
+  auto LocalRing() -> detail::LogRing&;
+
+  void RingDoorbell();
+
+  void Writer();
+
+  // Drains every ring into out, returns how many records there were
+  auto DrainAll(fmt::memory_buffer &out) -> std::size_t;
+
+  void WriteLocked(const fmt::memory_buffer &out);
+};
+
+} // bridge
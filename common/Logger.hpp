@@ -1,95 +1,102 @@
 #pragma once
 
 #include "common.hpp"
+#include "LogLevel.hpp"
+#include "LogSink.hpp"
 
 namespace bridge
 {
-namespace detail
-{
-
-struct logger_lock
-{
-  static inline boost::mutex mutex;
-};
-
-} // detail
 
+// domain is the key of the runtime level, see LogLevels
 template <
   char const* domain
 >
 class Logger
 {
+  // constant initialized, so it's good even before the registration below
+  static inline constinit std::atomic<LogLevel> level_ {DEFAULT_LOG_LEVEL};
+  static inline const bool registered_ =
+    (LogLevels::Register(domain, level_), true);
+
 public:
+  // A disabled call is the load and the branch, the record is built out of
+  // line
   template <typename... T>
   inline static void Debug(
-    [[maybe_unused]] const std::string& current_domain,
-    [[maybe_unused]] fmt::format_string<T...> fmt,
-    [[maybe_unused]] T&&... args)
+    LogScope current_domain,
+    fmt::format_string<T...> fmt,
+    T&&... args)
   {
-    #ifndef NDEBUG
-    PrintWithPrefix("DEBUG", current_domain, fmt, std::forward<T>(args)...);
-    #endif //NDEBUG
+    if (Level() == LogLevel::debug) [[unlikely]]
+    {
+      PrintWithPrefix("DEBUG", current_domain, fmt, std::forward<T>(args)...);
+    }
   }
 
   inline static void Debug(
-    [[maybe_unused]] const std::string& current_domain)
+    LogScope current_domain)
   {
-    #ifndef NDEBUG
-    PrintWithPrefix("DEBUG", current_domain);
-    #endif // NDEBUG
+    if (Level() == LogLevel::debug) [[unlikely]]
+    {
+      PrintWithPrefix("DEBUG", current_domain);
+    }
   }
 
   template <typename... T>
   inline static void Print(
-    [[maybe_unused]] const std::string& current_domain,
-    [[maybe_unused]] fmt::format_string<T...> fmt,
-    [[maybe_unused]] T&&... args)
+    LogScope current_domain,
+    fmt::format_string<T...> fmt,
+    T&&... args)
   {
-    PrintWithPrefix("LOG", current_domain, fmt, std::forward<T>(args)...);
+    if (Level() != LogLevel::off) [[likely]]
+    {
+      PrintWithPrefix("LOG", current_domain, fmt, std::forward<T>(args)...);
+    }
   }
 
   inline static void Print(
-    const std::string& current_domain)
+    LogScope current_domain)
   {
-    PrintWithPrefix("LOG", current_domain);
+    if (Level() != LogLevel::off) [[likely]]
+    {
+      PrintWithPrefix("LOG", current_domain);
+    }
+  }
+
+  [[nodiscard]] inline static auto Level() -> LogLevel
+  {
+    // naming it is what instantiates the registration
+    static_cast<void>(&registered_);
+    return level_.load(std::memory_order_relaxed);
   }
 
 private:
-  template <typename... T>
-  static void PrintWithPrefix(
-    const std::string& print_type,
-    const std::string& current_domain)
+  // Only the arguments are captured here, the line is formatted and written
+  // by the LogSink thread
+  [[gnu::noinline]] static void PrintWithPrefix(
+    std::string_view print_type,
+    LogScope current_domain)
   {
-    const std::string result = fmt::format(
-      "[{} - {}::{}]",
+    LogSink::Instance().Push(
       print_type,
       domain,
-      current_domain);
-
-    LockedPrint(result);
+      current_domain.View(),
+      std::nullopt);
   }
 
   template <typename... T>
-  static void PrintWithPrefix(
-    const std::string& print_type,
-    const std::string& current_domain,
+  [[gnu::noinline]] static void PrintWithPrefix(
+    std::string_view print_type,
+    LogScope current_domain,
     fmt::format_string<T...> fmt,
     T&&... args)
   {
-    const std::string result = fmt::format(
-      "[{} - {}::{}] {}",
+    LogSink::Instance().Push(
       print_type,
       domain,
-      current_domain,
-      fmt::format(fmt, std::forward<T>(args)...));
-
-    LockedPrint(result);
-  }
-
-  static void LockedPrint(const std::string& message)
-  {
-    boost::mutex::scoped_lock lock(detail::logger_lock::mutex);
-    fmt::println("{}", message);
+      current_domain.View(),
+      fmt::string_view(fmt),
+      std::forward<T>(args)...);
   }
 };
 
@@ -1,19 +1,574 @@
 #include "MessageFormat.hpp"
+#include "JsonScan.hpp"
+
+#include <charconv>
+#include <cstring>
 
 using namespace bridge;
 
+namespace
+{
+
+void Append(fmt::memory_buffer &out, std::string_view value)
+{
+  out.append(value.data(), value.data() + value.size());
+}
+
+} // namespace
+
 auto MessageFormatter::ConstructJson(const Message &msg) -> std::string
 {
-  return fmt::format(
-    "{{\"author\": \"{}\", \"message\": \"{}\", \"client\": \"{}\"}}",
-    msg.author, msg.message, msg.client);
+  thread_local fmt::memory_buffer buffer;
+
+  ConstructJson(msg, buffer);
+  return fmt::to_string(buffer);
+}
+
+void MessageFormatter::ConstructJson(
+  const Message &msg,
+  fmt::memory_buffer &out)
+{
+  out.clear();
+  Append(out, "{\"author\": \"");
+  AppendEscaped(out, msg.author);
+  Append(out, "\", \"message\": \"");
+  AppendEscaped(out, msg.message);
+  Append(out, "\", \"client\": \"");
+  AppendEscaped(out, msg.client);
+  Append(out, "\"}");
 }
 
-MessageParser::MessageParser(const std::string &message)
+void MessageFormatter::AppendEscaped(
+  fmt::memory_buffer &out,
+  std::string_view value)
 {
-  using namespace boost::property_tree;
+  // sized for the worst case, every byte as \u00XX, and cut down at the end
+  // so the loop below never has to check for space
+  const std::size_t offset = out.size();
+  out.resize(offset + value.size() * 6);
+  char *cursor = out.data() + offset;
+
+  std::size_t start = 0;
+  while (true)
+  {
+    const std::size_t special = detail::FindJsonSpecial(value, start);
+    if (special != start)
+    {
+      std::memcpy(cursor, value.data() + start, special - start);
+      cursor += special - start;
+    }
+    if (special == value.size())
+    {
+      break;
+    }
 
-  auto stream = std::istringstream(message);
-  json_parser::read_json(stream, tree_);
+    const char c = value[special];
+    *cursor++ = '\\';
+    switch (c)
+    {
+    case '"': *cursor++ = '"'; break;
+    case '\\': *cursor++ = '\\'; break;
+    case '\b': *cursor++ = 'b'; break;
+    case '\f': *cursor++ = 'f'; break;
+    case '\n': *cursor++ = 'n'; break;
+    case '\r': *cursor++ = 'r'; break;
+    case '\t': *cursor++ = 't'; break;
+    default:
+    {
+      // the rest of the control characters, always below 0x20
+      constexpr char hex[] = "0123456789abcdef";
+      *cursor++ = 'u';
+      *cursor++ = '0';
+      *cursor++ = '0';
+      *cursor++ = hex[c >> 4];
+      *cursor++ = hex[c & 0xF];
+      break;
+    }
+    }
+
+    start = special + 1;
+  }
+
+  out.resize(static_cast<std::size_t>(cursor - out.data()));
+}
+
+auto MessageFormatter::ConstructMarkdown(const Message &msg) -> std::string
+{
+  return fmt::format("**[{}] {}**: {}", msg.client, msg.author, msg.message);
 }
 
+namespace
+{
+
+// Walks a json text once, strings without escapes are returned as views into
+// the text, the rest is unescaped into the scratch buffer
+class JsonCursor
+{
+  static constexpr u32 max_depth = 64;
+
+  std::string_view data_;
+  std::size_t position_ = 0;
+  std::string &scratch_;
+
+public:
+  JsonCursor(std::string_view data, std::string &scratch)
+    : data_(data), scratch_(scratch) {}
+
+  [[nodiscard]] auto AtEnd() -> bool
+  {
+    SkipWhitespace();
+    return position_ == data_.size();
+  }
+
+  [[nodiscard]] auto Peek() -> char
+  {
+    SkipWhitespace();
+    return position_ < data_.size() ? data_[position_] : '\0';
+  }
+
+  [[nodiscard]] auto Consume(char expected) -> bool
+  {
+    if (Peek() != expected)
+    {
+      return false;
+    }
+
+    ++position_;
+    return true;
+  }
+
+  [[nodiscard]] auto ParseString(std::string_view &result) -> bool
+  {
+    if (!Consume('"'))
+    {
+      return false;
+    }
+
+    const std::size_t start = position_;
+    std::size_t special = detail::FindJsonSpecial(data_, position_);
+    if (special == data_.size())
+    {
+      return false;
+    }
+
+    if (data_[special] == '"')
+    {
+      result = data_.substr(start, special - start);
+      position_ = special + 1;
+      return true;
+    }
+
+    // a no-op after the first time, the views handed out so far stay valid
+    scratch_.reserve(data_.size());
+    const std::size_t unescaped_start = scratch_.size();
+    scratch_.append(data_.substr(start, special - start));
+    position_ = special;
+
+    while (data_[position_] == '\\')
+    {
+      if (!Unescape())
+      {
+        return false;
+      }
+
+      special = detail::FindJsonSpecial(data_, position_);
+      if (special == data_.size())
+      {
+        return false;
+      }
+
+      scratch_.append(data_.substr(position_, special - position_));
+      position_ = special;
+    }
+
+    // raw control characters aren't allowed in a string
+    if (data_[position_] != '"')
+    {
+      return false;
+    }
+
+    ++position_;
+    result = std::string_view(scratch_).substr(unescaped_start);
+    return true;
+  }
+
+  [[nodiscard]] auto ParseStringList(std::vector<std::string_view> &result)
+    -> bool
+  {
+    std::string_view value;
+    if (Peek() == '"')
+    {
+      if (!ParseString(value))
+      {
+        return false;
+      }
+
+      result.push_back(value);
+      return true;
+    }
+
+    if (!Consume('['))
+    {
+      return false;
+    }
+
+    if (Consume(']'))
+    {
+      return true;
+    }
+
+    do
+    {
+      if (!ParseString(value))
+      {
+        return false;
+      }
+
+      result.push_back(value);
+    }
+    while (Consume(','));
+
+    return Consume(']');
+  }
+
+  // Validates and steps over any value without keeping it
+  [[nodiscard]] auto SkipValue(u32 depth = 0) -> bool
+  {
+    if (depth > max_depth)
+    {
+      return false;
+    }
+
+    switch (Peek())
+    {
+    case '"':
+      return SkipString();
+
+    case '{':
+      ++position_;
+      if (Consume('}'))
+      {
+        return true;
+      }
+
+      do
+      {
+        if (!SkipString() || !Consume(':') || !SkipValue(depth + 1))
+        {
+          return false;
+        }
+      }
+      while (Consume(','));
+
+      return Consume('}');
+
+    case '[':
+      ++position_;
+      if (Consume(']'))
+      {
+        return true;
+      }
+
+      do
+      {
+        if (!SkipValue(depth + 1))
+        {
+          return false;
+        }
+      }
+      while (Consume(','));
+
+      return Consume(']');
+
+    case 't':
+      return SkipLiteral("true");
+
+    case 'f':
+      return SkipLiteral("false");
+
+    case 'n':
+      return SkipLiteral("null");
+
+    default:
+      return SkipNumber();
+    }
+  }
+
+private:
+  void SkipWhitespace()
+  {
+    while (position_ < data_.size() &&
+           (data_[position_] == ' ' || data_[position_] == '\n' ||
+            data_[position_] == '\r' || data_[position_] == '\t'))
+    {
+      ++position_;
+    }
+  }
+
+  // position_ is on the backslash
+  [[nodiscard]] auto Unescape() -> bool
+  {
+    u32 code_point = 0;
+    if (!ParseEscape(code_point))
+    {
+      return false;
+    }
+
+    AppendUtf8(code_point);
+    return true;
+  }
+
+  // position_ is on the backslash, it's moved past the escape, which is
+  // checked the same way whether the string is kept or skipped
+  [[nodiscard]] auto ParseEscape(u32 &code_point) -> bool
+  {
+    if (position_ + 1 >= data_.size())
+    {
+      return false;
+    }
+
+    const char escaped = data_[position_ + 1];
+    position_ += 2;
+
+    switch (escaped)
+    {
+    case '"': code_point = '"'; return true;
+    case '\\': code_point = '\\'; return true;
+    case '/': code_point = '/'; return true;
+    case 'b': code_point = '\b'; return true;
+    case 'f': code_point = '\f'; return true;
+    case 'n': code_point = '\n'; return true;
+    case 'r': code_point = '\r'; return true;
+    case 't': code_point = '\t'; return true;
+    case 'u': break;
+    default: return false;
+    }
+
+    if (!ParseHex(code_point))
+    {
+      return false;
+    }
+
+    // a high surrogate has to be followed by an escaped low one
+    if (code_point >= 0xD800 && code_point <= 0xDBFF)
+    {
+      u32 low = 0;
+      if (data_.substr(position_, 2) != "\\u")
+      {
+        return false;
+      }
+
+      position_ += 2;
+      if (!ParseHex(low) || low < 0xDC00 || low > 0xDFFF)
+      {
+        return false;
+      }
+
+      code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    }
+    else if (code_point >= 0xDC00 && code_point <= 0xDFFF)
+    {
+      return false;
+    }
+
+    return true;
+  }
+
+  [[nodiscard]] auto ParseHex(u32 &value) -> bool
+  {
+    if (position_ + 4 > data_.size())
+    {
+      return false;
+    }
+
+    auto [end, ec] = std::from_chars(
+      data_.data() + position_,
+      data_.data() + position_ + 4,
+      value,
+      16);
+    if (ec != std::errc {} || end != data_.data() + position_ + 4)
+    {
+      return false;
+    }
+
+    position_ += 4;
+    return true;
+  }
+
+  void AppendUtf8(u32 code_point)
+  {
+    if (code_point < 0x80)
+    {
+      scratch_.push_back(static_cast<char>(code_point));
+    }
+    else if (code_point < 0x800)
+    {
+      scratch_.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+      scratch_.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else if (code_point < 0x10000)
+    {
+      scratch_.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+      scratch_.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      scratch_.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+    else
+    {
+      scratch_.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+      scratch_.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+      scratch_.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      scratch_.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+  }
+
+  [[nodiscard]] auto SkipString() -> bool
+  {
+    if (!Consume('"'))
+    {
+      return false;
+    }
+
+    while (true)
+    {
+      position_ = detail::FindJsonSpecial(data_, position_);
+      if (position_ == data_.size())
+      {
+        return false;
+      }
+
+      const char c = data_[position_];
+      if (c == '"')
+      {
+        ++position_;
+        return true;
+      }
+
+      // a control character, or an escape the kept strings would reject
+      u32 code_point = 0;
+      if (c != '\\' || !ParseEscape(code_point))
+      {
+        return false;
+      }
+    }
+  }
+
+  [[nodiscard]] auto SkipLiteral(std::string_view literal) -> bool
+  {
+    if (data_.substr(position_, literal.size()) != literal)
+    {
+      return false;
+    }
+
+    position_ += literal.size();
+    return true;
+  }
+
+  [[nodiscard]] auto SkipNumber() -> bool
+  {
+    // from_chars would take inf and nan as well, with or without a minus
+    std::size_t digit = position_;
+    if (digit < data_.size() && data_[digit] == '-')
+    {
+      ++digit;
+    }
+    if (digit >= data_.size() || data_[digit] < '0' || data_[digit] > '9')
+    {
+      return false;
+    }
+
+    double value;
+    auto [end, ec] = std::from_chars(
+      data_.data() + position_,
+      data_.data() + data_.size(),
+      value);
+    if (ec != std::errc {} && ec != std::errc::result_out_of_range)
+    {
+      return false;
+    }
+
+    position_ = static_cast<std::size_t>(end - data_.data());
+    return true;
+  }
+};
+
+} // namespace
+
+MessageParser::MessageParser(std::string_view message)
+{
+  JsonCursor cursor(message, unescaped_);
+
+  const auto parse_member = [this, &cursor]() -> bool {
+    std::string_view key;
+    if (!cursor.ParseString(key) || !cursor.Consume(':'))
+    {
+      return false;
+    }
+
+    const auto parse_field = [&cursor](std::optional<std::string_view> &field)
+    {
+      std::string_view value;
+      if (cursor.Peek() != '"')
+      {
+        // not a string, so as good as missing
+        field.reset();
+        return cursor.SkipValue();
+      }
+
+      if (!cursor.ParseString(value))
+      {
+        return false;
+      }
+
+      field = value;
+      return true;
+    };
+
+    const auto parse_list =
+      [&cursor](std::optional<std::vector<std::string_view>> &list)
+    {
+      list.emplace();
+      return cursor.ParseStringList(*list);
+    };
+
+    if (key == "author")
+    {
+      return parse_field(author_);
+    }
+    if (key == "message")
+    {
+      return parse_field(message_);
+    }
+    if (key == "client")
+    {
+      return parse_field(client_);
+    }
+    if (key == "subscribe")
+    {
+      return parse_list(subscribe_);
+    }
+    if (key == "unsubscribe")
+    {
+      return parse_list(unsubscribe_);
+    }
+
+    return cursor.SkipValue();
+  };
+
+  bool parsed = cursor.Consume('{');
+  if (parsed && !cursor.Consume('}'))
+  {
+    do
+    {
+      parsed = parse_member();
+    }
+    while (parsed && cursor.Consume(','));
+
+    parsed = parsed && cursor.Consume('}');
+  }
+
+  valid_ = parsed && cursor.AtEnd();
+  if (!valid_)
+  {
+    Debug("Constructor", "malformed message");
+  }
+}
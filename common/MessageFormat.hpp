@@ -17,51 +17,101 @@ public:
     std::string client;
   };
 
+  // Renders through a buffer reused by every call on the thread, so the only
+  // allocation is the returned string
   [[nodiscard]] static auto ConstructJson(const Message &msg) -> std::string;
+
+  // Renders into out, which is cleared first
+  static void ConstructJson(const Message &msg, fmt::memory_buffer &out);
+
+  // Appends value as the inside of a json string, plain runs are found with
+  // detail::FindJsonSpecial and copied in one go
+  static void AppendEscaped(fmt::memory_buffer &out, std::string_view value);
+
+  // "**[client] author**: message", the way it's posted to Discord
+  [[nodiscard]] static auto ConstructMarkdown(const Message &msg)
+    -> std::string;
 };
 
 constexpr char MESSAGEPARSER_STR[] = "MessageParser";
+// Single pass parser for the {author, message, client} envelope and the
+// {subscribe}/{unsubscribe} control messages, unknown keys are skipped.
+// Never throws, the results are views into the message, strings with escapes
+// are unescaped into a buffer owned by the parser, so it can't be moved and
+// the message has to outlive it
 class MessageParser
   : private Logger<MESSAGEPARSER_STR>
 {
-  using outcome_type = detail::CheckedResult<std::string>;
+  using outcome_type = detail::CheckedResult<std::string_view>;
+  using list_outcome_type =
+    detail::CheckedResult<std::span<const std::string_view>>;
+
+  // reserved to the size of the message once, unescaping only ever shrinks
+  // so the views into it stay put
+  std::string unescaped_;
+  std::optional<std::string_view> author_;
+  std::optional<std::string_view> message_;
+  std::optional<std::string_view> client_;
+  std::optional<std::vector<std::string_view>> subscribe_;
+  std::optional<std::vector<std::string_view>> unsubscribe_;
+  bool valid_ = false;
 
-  boost::property_tree::ptree tree_;
 public:
-  MessageParser(const std::string &message);
+  explicit MessageParser(std::string_view message);
 
-  std::function<outcome_type()> GetContent = [this]() {
-    return detail::TreeGetValue<std::string>(tree_, "message");
-  };
+  MessageParser(const MessageParser&) = delete;
+  MessageParser& operator=(const MessageParser&) = delete;
 
-  std::function<outcome_type()> GetAuthor = [this]() {
-    return detail::TreeGetValue<std::string>(tree_, "author");
-  };
+  // False when the message isn't a well formed json object
+  [[nodiscard]] auto IsValid() const -> bool { return valid_; }
 
-  std::function<outcome_type()> GetClient = [this]() {
-    return detail::TreeGetValue<std::string>(tree_, "client");
-  };
-};
+  [[nodiscard]] auto GetContent() const -> outcome_type
+  {
+    return Field(message_);
+  }
 
-} // bridge
+  [[nodiscard]] auto GetAuthor() const -> outcome_type
+  {
+    return Field(author_);
+  }
 
-template <>
-struct fmt::formatter<bridge::MessageParser>
-{
-  template<typename ParseContext>
-  constexpr auto parse(ParseContext& ctx)
+  [[nodiscard]] auto GetClient() const -> outcome_type
+  {
+    return Field(client_);
+  }
+
+  // {"subscribe": ["client", ...]} control messages, never broadcast
+  [[nodiscard]] auto GetSubscribe() const -> list_outcome_type
+  {
+    return List(subscribe_);
+  }
+
+  [[nodiscard]] auto GetUnsubscribe() const -> list_outcome_type
   {
-    return ctx.begin();
+    return List(unsubscribe_);
   }
 
-  auto format(const bridge::MessageParser& val, format_context& ctx)
+private:
+  [[nodiscard]] auto Field(const std::optional<std::string_view> &field) const
+    -> outcome_type
   {
-    return fmt::format_to(
-      ctx.out(),
-      "**[{}] {}**: {}",
-      val.GetClient().value(),
-      val.GetAuthor().value(),
-      val.GetContent().value());
+    if (!valid_ || !field.has_value())
+    {
+      return outcome::failure(detail::Failure {});
+    }
+    return *field;
   }
 
+  [[nodiscard]] auto List(
+    const std::optional<std::vector<std::string_view>> &list) const
+    -> list_outcome_type
+  {
+    if (!valid_ || !list.has_value())
+    {
+      return outcome::failure(detail::Failure {});
+    }
+    return std::span<const std::string_view>(*list);
+  }
 };
+
+} // bridge
@@ -0,0 +1,225 @@
+#include "Metrics.hpp"
+
+#include <cmath>
+#include <mutex>
+
+using namespace bridge;
+
+namespace
+{
+
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<const Metric*> metrics;
+};
+
+auto GetRegistry() -> Registry&
+{
+  // metrics are static members all over, registered in no particular order
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+void Append(fmt::memory_buffer &out, std::string_view value)
+{
+  out.append(value.data(), value.data() + value.size());
+}
+
+} // namespace
+
+Metric::Metric(
+  std::string_view name,
+  std::string_view help,
+  std::string_view labels)
+  : name_(name),
+    help_(help),
+    labels_(labels)
+{
+  Registry &registry = GetRegistry();
+  std::scoped_lock lock(registry.mutex);
+  registry.metrics.push_back(this);
+}
+
+Metric::~Metric()
+{
+  Registry &registry = GetRegistry();
+  std::scoped_lock lock(registry.mutex);
+  std::erase(registry.metrics, this);
+}
+
+auto Metric::Render() -> std::string
+{
+  Registry &registry = GetRegistry();
+  fmt::memory_buffer out;
+
+  std::scoped_lock lock(registry.mutex);
+
+  // a family has to be contiguous and is described once
+  std::vector<const Metric*> metrics = registry.metrics;
+  std::ranges::stable_sort(metrics, {}, &Metric::Name);
+
+  std::string_view family;
+  for (const Metric *metric : metrics)
+  {
+    if (metric->Name() != family)
+    {
+      family = metric->Name();
+      fmt::format_to(
+        std::back_inserter(out),
+        "# HELP {} {}\n# TYPE {} {}\n",
+        family,
+        metric->Help(),
+        family,
+        metric->Type());
+    }
+
+    metric->Write(out);
+  }
+
+  return fmt::to_string(out);
+}
+
+void Metric::WriteSample(
+  fmt::memory_buffer &out,
+  std::string_view suffix,
+  std::string_view extra,
+  double value) const
+{
+  Append(out, name_);
+  Append(out, suffix);
+
+  if (!labels_.empty() || !extra.empty())
+  {
+    const std::string_view separator =
+      labels_.empty() || extra.empty() ? "" : ",";
+    fmt::format_to(
+      std::back_inserter(out),
+      "{{{}{}{}}}",
+      labels_,
+      separator,
+      extra);
+  }
+
+  fmt::format_to(std::back_inserter(out), " {}\n", value);
+}
+
+auto Counter::Value() const -> u64
+{
+  u64 value = 0;
+  for (const Stripe &stripe : stripes_)
+  {
+    value += stripe.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+void Counter::Write(fmt::memory_buffer &out) const
+{
+  WriteSample(out, "", "", static_cast<double>(Value()));
+}
+
+void Gauge::Write(fmt::memory_buffer &out) const
+{
+  WriteSample(
+    out,
+    "",
+    "",
+    static_cast<double>(value_.load(std::memory_order_relaxed)));
+}
+
+Histogram::Histogram(
+  std::string_view name,
+  std::string_view help,
+  u64 lowest,
+  u64 highest,
+  double scale,
+  std::string_view labels)
+  : Metric(name, help, labels),
+    lowest_exponent_(std::min<u32>(63, std::bit_width(lowest))),
+    highest_exponent_(
+      std::max(lowest_exponent_, std::min<u32>(63, std::bit_width(highest)))),
+    scale_(scale)
+{
+}
+
+auto Histogram::Quantile(double q) const -> double
+{
+  std::array<u64, BUCKETS> counts;
+  u64 total = 0;
+  for (std::size_t i = 0; i < BUCKETS; ++i)
+  {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+
+  if (total == 0)
+  {
+    return 0;
+  }
+
+  const u64 rank = std::max<u64>(
+    1,
+    static_cast<u64>(std::ceil(std::clamp(q, 0.0, 1.0) * total)));
+
+  u64 cumulative = 0;
+  for (std::size_t i = 0; i + 1 < BUCKETS; ++i)
+  {
+    cumulative += counts[i];
+    if (cumulative >= rank)
+    {
+      return static_cast<double>(LowerBound(i + 1) - 1) * scale_;
+    }
+  }
+  return static_cast<double>(LowerBound(BUCKETS - 1)) * scale_;
+}
+
+auto Histogram::Count() const -> u64
+{
+  u64 total = 0;
+  for (const auto &bucket : buckets_)
+  {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+void Histogram::Write(fmt::memory_buffer &out) const
+{
+  // a snapshot first, the buckets keep moving while this runs
+  std::array<u64, BUCKETS> counts;
+  for (std::size_t i = 0; i < BUCKETS; ++i)
+  {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+
+  // a power of two starts a bucket, so the values below it are exact
+  u64 cumulative = 0;
+  std::size_t next = 0;
+  for (u32 exponent = lowest_exponent_; exponent <= highest_exponent_;
+       ++exponent)
+  {
+    const u64 bound = u64 {1} << exponent;
+    for (; next < BucketOf(bound); ++next)
+    {
+      cumulative += counts[next];
+    }
+    WriteSample(
+      out,
+      "_bucket",
+      fmt::format("le=\"{:.9g}\"", static_cast<double>(bound - 1) * scale_),
+      static_cast<double>(cumulative));
+  }
+
+  for (; next < BUCKETS; ++next)
+  {
+    cumulative += counts[next];
+  }
+  WriteSample(out, "_bucket", "le=\"+Inf\"", static_cast<double>(cumulative));
+  WriteSample(
+    out,
+    "_sum",
+    "",
+    static_cast<double>(sum_.load(std::memory_order_relaxed)) * scale_);
+  WriteSample(out, "_count", "", static_cast<double>(cumulative));
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace bridge
+{
+
+// Anything the /metrics endpoint exports, every instance registers itself on
+// construction. Instances with the same name are one family told apart by
+// their labels, e.g. participant="client"
+class Metric
+{
+  const std::string_view name_;
+  const std::string_view help_;
+  const std::string_view labels_;
+
+public:
+  Metric(
+    std::string_view name,
+    std::string_view help,
+    std::string_view labels = {});
+
+  virtual ~Metric();
+
+  Metric(const Metric&) = delete;
+  Metric& operator=(const Metric&) = delete;
+
+  [[nodiscard]] auto Name() const -> std::string_view { return name_; }
+
+  [[nodiscard]] auto Help() const -> std::string_view { return help_; }
+
+  // counter, gauge or histogram
+  [[nodiscard]] virtual auto Type() const -> std::string_view = 0;
+
+  // The samples in the Prometheus text format, without # HELP and # TYPE
+  virtual void Write(fmt::memory_buffer &out) const = 0;
+
+  // Every registered metric in the Prometheus text format
+  [[nodiscard]] static auto Render() -> std::string;
+
+protected:
+  // name{labels} or name{labels,extra} and the value
+  void WriteSample(
+    fmt::memory_buffer &out,
+    std::string_view suffix,
+    std::string_view extra,
+    double value) const;
+};
+
+namespace detail
+{
+
+inline constexpr std::size_t METRIC_STRIPES = 16;
+
+// The stripe of the calling thread, handed out round robin
+[[nodiscard]] inline auto MetricStripe() -> std::size_t
+{
+  static std::atomic<std::size_t> next = 0;
+  thread_local const std::size_t stripe =
+    next.fetch_add(1, std::memory_order_relaxed) % METRIC_STRIPES;
+  return stripe;
+}
+
+} // detail
+
+// Monotonic, every thread adds to its own cache line and a scrape sums them
+class Counter final
+  : public Metric
+{
+  struct alignas(64) Stripe
+  {
+    std::atomic<u64> value = 0;
+  };
+
+  std::array<Stripe, detail::METRIC_STRIPES> stripes_;
+
+public:
+  using Metric::Metric;
+
+  void Add(u64 value = 1)
+  {
+    stripes_[detail::MetricStripe()].value.fetch_add(
+      value,
+      std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto Value() const -> u64;
+
+  [[nodiscard]] auto Type() const -> std::string_view override
+  {
+    return "counter";
+  }
+
+  void Write(fmt::memory_buffer &out) const override;
+};
+
+// Last value set, for things that are sampled like a queue depth
+class Gauge final
+  : public Metric
+{
+  std::atomic<i64> value_ = 0;
+
+public:
+  using Metric::Metric;
+
+  void Set(i64 value) { value_.store(value, std::memory_order_relaxed); }
+
+  [[nodiscard]] auto Type() const -> std::string_view override
+  {
+    return "gauge";
+  }
+
+  void Write(fmt::memory_buffer &out) const override;
+};
+
+// HDR style log-linear histogram of unsigned values: exact below 8, above
+// that every power of two is split into 8 buckets, so any value is within
+// 12.5% of its bucket. Exported are the les one below a power of two, from
+// the first at least lowest to the first at least highest, both in the
+// recorded unit, so every scrape has the same le set whatever was recorded.
+// scale converts the recorded unit to the exported one, e.g. 1e-9 for
+// nanoseconds exported as seconds
+class Histogram final
+  : public Metric
+{
+  static constexpr u32 SUB_BUCKET_BITS = 3;
+  static constexpr u32 SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static constexpr std::size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) *
+                                         SUB_BUCKETS;
+
+  const u32 lowest_exponent_;
+  const u32 highest_exponent_;
+  const double scale_;
+  std::array<std::atomic<u64>, BUCKETS> buckets_ {};
+  std::atomic<u64> sum_ = 0;
+
+public:
+  Histogram(
+    std::string_view name,
+    std::string_view help,
+    u64 lowest,
+    u64 highest,
+    double scale = 1,
+    std::string_view labels = {});
+
+  void Record(u64 value)
+  {
+    buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  // Nanoseconds from start to now
+  void RecordSince(
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now())
+  {
+    Record(static_cast<u64>(std::max<i64>(
+      0,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        now - start).count())));
+  }
+
+  [[nodiscard]] static constexpr auto BucketOf(u64 value) -> std::size_t
+  {
+    if (value < SUB_BUCKETS)
+    {
+      return value;
+    }
+
+    const u32 exponent = std::bit_width(value) - 1;
+    const u64 sub_bucket =
+      (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+  }
+
+  // The smallest value that lands in bucket
+  [[nodiscard]] static constexpr auto LowerBound(std::size_t bucket) -> u64
+  {
+    if (bucket < SUB_BUCKETS)
+    {
+      return bucket;
+    }
+
+    const u32 exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    return (SUB_BUCKETS + bucket % SUB_BUCKETS) <<
+           (exponent - SUB_BUCKET_BITS);
+  }
+
+  // The upper bound of the bucket holding the q quantile, in the exported
+  // unit, 0 while it's empty
+  [[nodiscard]] auto Quantile(double q) const -> double;
+
+  [[nodiscard]] auto Count() const -> u64;
+
+  [[nodiscard]] auto Type() const -> std::string_view override
+  {
+    return "histogram";
+  }
+
+  // One bucket per exported le, the buckets in between are only added up
+  void Write(fmt::memory_buffer &out) const override;
+};
+
+} // bridge
@@ -0,0 +1,89 @@
+#include "MetricsServer.hpp"
+
+using namespace bridge;
+
+using boost::asio::co_spawn;
+using boost::asio::detached;
+using boost::asio::use_awaitable;
+using boost::asio::awaitable;
+using boost::asio::ip::tcp;
+
+namespace http = beast::http;
+
+MetricsServer::MetricsServer(u16 port)
+{
+  if (port == 0)
+  {
+    return;
+  }
+
+  co_spawn(io_, DealWithAccepting({io_, {tcp::v4(), port}}), detached);
+  thread_ = std::thread([this] { io_.run(); });
+
+  Print("Constructor", "Metrics on Port: {}", port);
+}
+
+MetricsServer::~MetricsServer()
+{
+  io_.stop();
+  if (thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+awaitable<void> MetricsServer::DealWithAccepting(tcp::acceptor acceptor)
+{
+  while (true)
+  {
+    auto socket = co_await acceptor.async_accept(use_awaitable);
+    co_spawn(io_, Session(std::move(socket)), detached);
+    Debug("DealWithAccepting()", "started session");
+  }
+}
+
+awaitable<void> MetricsServer::Session(tcp::socket socket)
+{
+  beast::tcp_stream stream(std::move(socket));
+  beast::flat_buffer buffer;
+
+  try
+  {
+    while (true)
+    {
+      stream.expires_after(std::chrono::seconds(30));
+
+      http::request<http::empty_body> request;
+      co_await http::async_read(stream, buffer, request, use_awaitable);
+
+      const std::string_view target(
+        request.target().data(),
+        request.target().size());
+      const bool found = request.method() == http::verb::get &&
+                         target.substr(0, target.find('?')) == "/metrics";
+
+      http::response<http::string_body> response {
+        found ? http::status::ok : http::status::not_found,
+        request.version()};
+      response.keep_alive(request.keep_alive());
+      response.set(
+        http::field::content_type,
+        found ? "text/plain; version=0.0.4" : "text/plain");
+      response.body() = found ? Metric::Render() : "not found\n";
+      response.prepare_payload();
+
+      co_await http::async_write(stream, response, use_awaitable);
+      if (!response.keep_alive())
+      {
+        break;
+      }
+    }
+  }
+  catch (std::exception &e)
+  {
+    Debug("Session()", "caught: {}", e.what());
+  }
+
+  beast::error_code ec;
+  stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+}
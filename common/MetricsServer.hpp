@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+
+namespace bridge
+{
+
+// Serves GET /metrics in the Prometheus text format on its own port, with its
+// own io_context and thread so a scrape never runs on the chat's threads.
+// Port 0 leaves it off
+constexpr char METRICSSERVER_STR[] = "MetricsServer";
+class MetricsServer
+  : private Logger<METRICSSERVER_STR>
+{
+  asio::io_context io_;
+  std::thread thread_;
+
+public:
+  [[nodiscard]] explicit MetricsServer(u16 port);
+
+  ~MetricsServer();
+
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+
+private:
+  asio::awaitable<void> DealWithAccepting(asio::ip::tcp::acceptor acceptor);
+
+  asio::awaitable<void> Session(asio::ip::tcp::socket socket);
+};
+
+} // bridge
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace bridge
+{
+
+// Bounded lock free multi producer single consumer queue, a ring of cells
+// each carrying a sequence number (D. Vyukov's bounded queue). Producers
+// only contend on a single fetch, the consumer never touches a lock.
+template <typename T>
+class BoundedMpscQueue
+{
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence;
+    T data;
+  };
+
+  // keep the producer and consumer cursors on separate cache lines
+  static constexpr std::size_t cache_line = 64;
+
+  std::unique_ptr<Cell[]> cells_;
+  const std::size_t mask_;
+  alignas(cache_line) std::atomic<std::size_t> enqueue_position_ = 0;
+  // only written by the consumer, atomic so the size can be sampled
+  alignas(cache_line) std::atomic<std::size_t> dequeue_position_ = 0;
+
+  static auto RoundUpCapacity(std::size_t capacity) -> std::size_t
+  {
+    return std::bit_ceil(std::max<std::size_t>(capacity, 2));
+  }
+
+public:
+  [[nodiscard]] explicit BoundedMpscQueue(std::size_t capacity)
+    : cells_(std::make_unique<Cell[]>(RoundUpCapacity(capacity))),
+      mask_(RoundUpCapacity(capacity) - 1)
+  {
+    for (std::size_t i = 0; i <= mask_; ++i)
+    {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedMpscQueue(const BoundedMpscQueue&) = delete;
+  BoundedMpscQueue& operator=(const BoundedMpscQueue&) = delete;
+
+  // Safe from any thread, fails when the queue is full
+  [[nodiscard]] auto TryPush(T &&value) -> bool
+  {
+    std::size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Cell *cell;
+
+    while (true)
+    {
+      cell = &cells_[position & mask_];
+      const std::size_t sequence =
+        cell->sequence.load(std::memory_order_acquire);
+      const auto difference =
+        static_cast<std::ptrdiff_t>(sequence) -
+        static_cast<std::ptrdiff_t>(position);
+
+      if (difference == 0)
+      {
+        if (enqueue_position_.compare_exchange_weak(
+              position,
+              position + 1,
+              std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (difference < 0)
+      {
+        // the consumer hasn't freed this cell yet
+        return false;
+      }
+      else
+      {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = std::move(value);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only ever call this from the single consumer
+  [[nodiscard]] auto TryPop(T &value) -> bool
+  {
+    const std::size_t position =
+      dequeue_position_.load(std::memory_order_relaxed);
+    Cell &cell = cells_[position & mask_];
+    const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+    if (sequence != position + 1)
+    {
+      return false;
+    }
+
+    value = std::move(cell.data);
+    cell.data = T {};
+    cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+    dequeue_position_.store(position + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  [[nodiscard]] auto Capacity() const -> std::size_t
+  {
+    return mask_ + 1;
+  }
+
+  // Only a snapshot, safe to call from any thread
+  [[nodiscard]] auto ApproximateSize() const -> std::size_t
+  {
+    const std::size_t dequeued =
+      dequeue_position_.load(std::memory_order_relaxed);
+    const std::size_t enqueued =
+      enqueue_position_.load(std::memory_order_relaxed);
+
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+};
+
+} // bridge
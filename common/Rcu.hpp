@@ -0,0 +1,168 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace bridge
+{
+
+namespace detail
+{
+
+inline constexpr std::size_t RCU_STRIPES = 16;
+
+// The reader stripe of the calling thread, handed out round robin
+[[nodiscard]] inline auto RcuStripe() -> std::size_t
+{
+  static std::atomic<std::size_t> next = 0;
+  thread_local const std::size_t stripe =
+    next.fetch_add(1, std::memory_order_relaxed) % RCU_STRIPES;
+  return stripe;
+}
+
+} // detail
+
+// Read-copy-update cell holding an immutable T. Readers pin whatever value
+// is current without a lock, they only count themselves into one of two
+// epochs on their thread's own cache line. Publish() swaps in a new value
+// and retires the old one, which is freed after a grace period: the epoch
+// moves on whenever the half of the epoch before is found drained, and a
+// value retired in epoch e is freed once the epoch reached e + 2, since a
+// reader may have taken the epoch right before it moved (the two phase
+// scheme of SRCU). Nothing waits for the readers, every Publish() moves the
+// epoch as far as it can and frees what's due. New readers always go to the
+// half that isn't drained, so a busy read side can't starve it. Publish() is
+// for one writer at a time, serializing writers is up to the owner
+template <typename T>
+class RcuCell
+{
+  struct alignas(64) Stripe
+  {
+    std::array<std::atomic<u64>, 2> readers {};
+  };
+
+  struct Retired
+  {
+    u64 epoch;
+    const T *value;
+  };
+
+  std::atomic<const T*> current_;
+  std::atomic<u64> epoch_ = 0;
+  mutable std::array<Stripe, detail::RCU_STRIPES> stripes_;
+  // only touched by the writer
+  std::vector<Retired> retired_;
+
+public:
+  // Keeps the value it was handed alive, never outlives the cell
+  class ReadGuard
+  {
+    std::atomic<u64> *readers_;
+    const T *value_;
+
+    friend class RcuCell;
+
+    ReadGuard(std::atomic<u64> *readers, const T *value)
+      : readers_(readers),
+        value_(value)
+    {
+    }
+
+  public:
+    ReadGuard(ReadGuard &&other) noexcept
+      : readers_(std::exchange(other.readers_, nullptr)),
+        value_(other.value_)
+    {
+    }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+    ReadGuard& operator=(ReadGuard&&) = delete;
+
+    ~ReadGuard()
+    {
+      if (readers_ != nullptr)
+      {
+        readers_->fetch_sub(1, std::memory_order_seq_cst);
+      }
+    }
+
+    [[nodiscard]] auto operator->() const -> const T* { return value_; }
+
+    [[nodiscard]] auto operator*() const -> const T& { return *value_; }
+  };
+
+  [[nodiscard]] explicit RcuCell(std::unique_ptr<const T> value)
+    : current_(value.release())
+  {
+  }
+
+  RcuCell(const RcuCell&) = delete;
+  RcuCell& operator=(const RcuCell&) = delete;
+
+  ~RcuCell()
+  {
+    for (const Retired &retired : retired_)
+    {
+      delete retired.value;
+    }
+    delete current_.load(std::memory_order_relaxed);
+  }
+
+  // Safe from any thread, the value stays put while the guard lives
+  [[nodiscard]] auto Read() const -> ReadGuard
+  {
+    auto &readers = stripes_[detail::RcuStripe()].readers;
+    const u64 epoch = epoch_.load(std::memory_order_seq_cst) & 1;
+    readers[epoch].fetch_add(1, std::memory_order_seq_cst);
+
+    return {&readers[epoch], current_.load(std::memory_order_seq_cst)};
+  }
+
+  // Makes value the current one, the previous value is freed by this or a
+  // later Publish() once no reader can still see it
+  void Publish(std::unique_ptr<const T> value)
+  {
+    const u64 epoch = epoch_.load(std::memory_order_seq_cst);
+    retired_.push_back(
+      {epoch, current_.exchange(value.release(), std::memory_order_seq_cst)});
+
+    Reclaim();
+  }
+
+private:
+  [[nodiscard]] auto Drained(u64 half) const -> bool
+  {
+    return std::ranges::all_of(stripes_, [half](const Stripe &stripe) {
+      return stripe.readers[half].load(std::memory_order_seq_cst) == 0;
+    });
+  }
+
+  // Moves the epoch on as far as the readers allow and frees the values
+  // retired two epochs ago or earlier
+  void Reclaim()
+  {
+    for (u32 phase = 0; phase < 2 && !retired_.empty(); ++phase)
+    {
+      const u64 epoch = epoch_.load(std::memory_order_seq_cst);
+      // the readers of the epoch before, new ones go to the other half
+      if (!Drained((epoch + 1) & 1))
+      {
+        break;
+      }
+
+      epoch_.store(epoch + 1, std::memory_order_seq_cst);
+    }
+
+    const u64 epoch = epoch_.load(std::memory_order_seq_cst);
+    std::erase_if(retired_, [epoch](const Retired &retired) {
+      if (epoch < retired.epoch + 2)
+      {
+        return false;
+      }
+      delete retired.value;
+      return true;
+    });
+  }
+};
+
+} // bridge
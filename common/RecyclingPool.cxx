@@ -0,0 +1,192 @@
+#include "RecyclingPool.hpp"
+
+using namespace bridge;
+
+namespace
+{
+
+struct FreeBlock
+{
+  FreeBlock *next;
+};
+
+// Free blocks of one size class, linked through the blocks themselves
+struct FreeList
+{
+  FreeBlock *head = nullptr;
+  u32 size = 0;
+
+  void Push(void *block)
+  {
+    head = new (block) FreeBlock {head};
+    ++size;
+  }
+
+  [[nodiscard]] auto Pop() -> void*
+  {
+    FreeBlock *block = head;
+    head = block->next;
+    --size;
+    return block;
+  }
+
+  // The first count blocks as a list of their own
+  [[nodiscard]] auto Split(u32 count) -> FreeList
+  {
+    FreeList taken;
+    while (taken.size < count)
+    {
+      taken.Push(Pop());
+    }
+    return taken;
+  }
+
+  void Release()
+  {
+    while (head != nullptr)
+    {
+      ::operator delete(Pop());
+    }
+  }
+};
+
+// Full batches passed between the threads, one lock per size class
+struct alignas(64) Depot
+{
+  std::mutex mutex;
+  std::vector<FreeList> batches;
+};
+
+// Trivially destructible, so a block freed by another thread_local's or a
+// static's destructor still finds it after the thread let go of its blocks
+struct ThreadLists
+{
+  std::array<FreeList, RECYCLING_SIZE_CLASSES> lists;
+  bool flushing = false;
+  bool flushed = false;
+};
+static_assert(std::is_trivially_destructible_v<ThreadLists>);
+
+thread_local ThreadLists thread_lists;
+
+// Hands the thread's blocks back to the heap when it exits, from then on it
+// allocates from and frees straight to the heap
+struct ThreadFlush
+{
+  ~ThreadFlush()
+  {
+    thread_lists.flushed = true;
+    for (FreeList &list : thread_lists.lists)
+    {
+      list.Release();
+    }
+  }
+};
+
+// The thread's lists, nullptr once they were flushed
+auto Lists() -> ThreadLists*
+{
+  if (thread_lists.flushed)
+  {
+    return nullptr;
+  }
+  if (!thread_lists.flushing)
+  {
+    // registers the flush on the thread's first use of the pool
+    thread_local ThreadFlush flush;
+    thread_lists.flushing = true;
+  }
+  return &thread_lists;
+}
+
+// Never destroyed, batches left at exit are the heap's problem
+auto Depots() -> std::array<Depot, RECYCLING_SIZE_CLASSES>&
+{
+  static auto *depots = new std::array<Depot, RECYCLING_SIZE_CLASSES>;
+  return *depots;
+}
+
+auto ClassOf(std::size_t size) -> std::size_t
+{
+  return (std::max<std::size_t>(size, 1) - 1) / RECYCLING_BLOCK_STEP;
+}
+
+auto BlockSize(std::size_t size_class) -> std::size_t
+{
+  return (size_class + 1) * RECYCLING_BLOCK_STEP;
+}
+
+auto Pooled(std::size_t size) -> bool
+{
+  return RECYCLING_POOL_BYTES != 0 && size <= RECYCLING_MAX_BLOCK;
+}
+
+} // namespace
+
+auto RecyclingPool::Allocate(std::size_t size) -> void*
+{
+  ThreadLists *lists = Pooled(size) ? Lists() : nullptr;
+  if (lists == nullptr)
+  {
+    heap_allocations.Add();
+    // always the whole block, it may be freed into a list once the pool is on
+    return ::operator new(
+      size > RECYCLING_MAX_BLOCK ? size : BlockSize(ClassOf(size)));
+  }
+
+  const std::size_t size_class = ClassOf(size);
+  FreeList &list = lists->lists[size_class];
+  if (list.head == nullptr)
+  {
+    Depot &depot = Depots()[size_class];
+    std::scoped_lock lock(depot.mutex);
+    if (!depot.batches.empty())
+    {
+      list = depot.batches.back();
+      depot.batches.pop_back();
+    }
+  }
+
+  if (list.head == nullptr)
+  {
+    heap_allocations.Add();
+    return ::operator new(BlockSize(size_class));
+  }
+
+  recycled_allocations.Add();
+  return list.Pop();
+}
+
+void RecyclingPool::Deallocate(void *block, std::size_t size) noexcept
+{
+  ThreadLists *lists = Pooled(size) ? Lists() : nullptr;
+  if (lists == nullptr)
+  {
+    ::operator delete(block);
+    return;
+  }
+
+  const std::size_t size_class = ClassOf(size);
+  FreeList &list = lists->lists[size_class];
+  list.Push(block);
+  if (list.size < 2 * RECYCLING_BATCH_BLOCKS)
+  {
+    return;
+  }
+
+  // keeps a batch for the next allocations, the other one is shared
+  FreeList batch = list.Split(RECYCLING_BATCH_BLOCKS);
+  const std::size_t max_batches = RECYCLING_POOL_BYTES /
+                                  (BlockSize(size_class) *
+                                   RECYCLING_BATCH_BLOCKS);
+  {
+    Depot &depot = Depots()[size_class];
+    std::scoped_lock lock(depot.mutex);
+    if (depot.batches.size() < max_batches)
+    {
+      depot.batches.push_back(batch);
+      return;
+    }
+  }
+  batch.Release();
+}
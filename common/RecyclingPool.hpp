@@ -0,0 +1,102 @@
+#pragma once
+
+#include "common.hpp"
+#include "Metrics.hpp"
+
+namespace bridge
+{
+
+// blocks come in steps of RECYCLING_BLOCK_STEP bytes, anything bigger than
+// RECYCLING_MAX_BLOCK goes straight to the heap
+inline constexpr std::size_t RECYCLING_BLOCK_STEP = 64;
+inline constexpr std::size_t RECYCLING_MAX_BLOCK = 4096;
+inline constexpr std::size_t RECYCLING_SIZE_CLASSES =
+  RECYCLING_MAX_BLOCK / RECYCLING_BLOCK_STEP;
+// what a thread hands to or takes from the shared depot at once
+inline constexpr u32 RECYCLING_BATCH_BLOCKS = 32;
+
+// Recycles the blocks every connection and every message makes and throws
+// away again: the sessions and the handlers posted to their strands, the
+// frames of their coroutines are left to asio's own per-thread recycling.
+// Every thread keeps a short free list per size class and trades whole
+// batches with a depot shared by all threads, so a block freed on another
+// thread than the one that made it still comes back, and the depot's lock is
+// only taken once per RECYCLING_BATCH_BLOCKS. The depot keeps up to
+// RECYCLING_POOL_BYTES of every size class, the rest goes back to the heap.
+// With RECYCLING_POOL_BYTES at 0 it's a plain operator new
+class RecyclingPool
+{
+public:
+  static inline Counter heap_allocations {
+    "bridge_pool_heap_allocations_total",
+    "Blocks the recycling pool had to take from the heap"};
+  static inline Counter recycled_allocations {
+    "bridge_pool_recycled_allocations_total",
+    "Blocks the recycling pool handed out again"};
+
+  [[nodiscard]] static auto Allocate(std::size_t size) -> void*;
+
+  // size is the one the block was allocated with, any thread may free it
+  static void Deallocate(void *block, std::size_t size) noexcept;
+};
+
+// std allocator on the RecyclingPool, for std::allocate_shared and as the
+// associated allocator of asio handlers
+template <typename T>
+class RecyclingAllocator
+{
+public:
+  using value_type = T;
+
+  RecyclingAllocator() noexcept = default;
+
+  template <typename U>
+  RecyclingAllocator([[maybe_unused]] const RecyclingAllocator<U> &other)
+    noexcept
+  {
+  }
+
+  [[nodiscard]] auto allocate(std::size_t count) -> T*
+  {
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    return static_cast<T*>(RecyclingPool::Allocate(count * sizeof(T)));
+  }
+
+  void deallocate(T *pointer, std::size_t count) noexcept
+  {
+    RecyclingPool::Deallocate(pointer, count * sizeof(T));
+  }
+
+  friend auto operator==(
+    [[maybe_unused]] const RecyclingAllocator &lhs,
+    [[maybe_unused]] const RecyclingAllocator &rhs) -> bool
+  {
+    return true;
+  }
+};
+
+// A function for asio::post and friends whose operation is allocated from
+// the RecyclingPool. asio only asks the handler for an allocator when the
+// executor it's posted to is a concrete one, any_io_executor drops it
+template <typename Function>
+class RecycledHandler
+{
+  Function function_;
+
+public:
+  using allocator_type = RecyclingAllocator<void>;
+
+  explicit RecycledHandler(Function function)
+    : function_(std::move(function))
+  {
+  }
+
+  [[nodiscard]] auto get_allocator() const noexcept -> allocator_type
+  {
+    return {};
+  }
+
+  void operator()() { function_(); }
+};
+
+} // bridge
@@ -1,4 +1,7 @@
 #include "Server.hpp"
+#include "FrameDeflate.hpp"
+#include "MessageFormat.hpp"
+#include "WebSocketFrame.hpp"
 
 using namespace bridge;
 
@@ -9,14 +12,36 @@ using boost::asio::awaitable;
 using boost::asio::ip::tcp;
 
 ClientChatSession::ClientChatSession(
-  tcp::socket &&tcp_socket,
+  StrandSocket &&tcp_socket,
   const std::shared_ptr<ThreadSafeChatRoom> &room)
-  : socket_(std::move(tcp_socket)), timer_(socket_.get_executor()),
+  : strand_(tcp_socket.get_executor()),
+    socket_(std::move(tcp_socket)), timer_(socket_.get_executor()),
+    stall_timer_(socket_.get_executor()),
     room_(room)
 {
   Debug("Constructor");
 
   timer_.expires_at(std::chrono::steady_clock::time_point::max());
+
+  if (DEFLATE_LEVEL != 0)
+  {
+    // beast only inflates what the client sends, the writer compresses its
+    // frames itself, each on its own
+    beast::websocket::permessage_deflate deflate;
+    deflate.server_enable = true;
+    deflate.server_no_context_takeover = true;
+    socket_.set_option(deflate);
+
+    // the response already carries what beast agreed on
+    socket_.set_option(beast::websocket::stream_base::decorator(
+      [this](beast::websocket::response_type &response) {
+        const auto extensions =
+          response[beast::http::field::sec_websocket_extensions];
+        auto window_bits = FrameDeflate::NegotiatedWindowBits(
+          {extensions.data(), extensions.size()});
+        deflate_window_bits_ = window_bits.value_or(0);
+      }));
+  }
 }
 
 ClientChatSession::~ClientChatSession()
@@ -56,14 +81,20 @@ awaitable<void> ClientChatSession::Reader()
       Debug("Reader()", "iteration start");
 
       co_await socket_.async_read(buffer, use_awaitable);
-      auto msg = beast::buffers_to_string(buffer.data());
-      Debug("Reader()", "read async message: {}", msg);
+      auto content = beast::buffers_to_string(buffer.data());
+      buffer.clear();
+      Debug("Reader()", "read async message: {}", content);
 
-      room_->DeliverMessage(shared_from_this(), msg);
-      Debug("Reader()", "delivering message");
+      // the only parse of the payload, every receiver shares it from here on
+      auto message = ParseIncoming(std::move(content));
+      if (!message)
+      {
+        continue;
+      }
 
-      buffer.clear();
-      Debug("Reader()", "buffer cleared");
+      room_->DeliverMessage(shared_from_this(), message);
+      messages_in.Add();
+      Debug("Reader()", "delivering message");
     }
   }
   catch (std::exception &e)
@@ -74,10 +105,71 @@ awaitable<void> ClientChatSession::Reader()
   }
 }
 
+auto ClientChatSession::ParseIncoming(std::string &&content) -> ChatMessagePtr
+{
+  MessageParser parser(content);
+  if (!parser.IsValid())
+  {
+    Debug("ParseIncoming()", "rejected, not json");
+    return nullptr;
+  }
+
+  auto subscribe = parser.GetSubscribe();
+  auto unsubscribe = parser.GetUnsubscribe();
+  if (subscribe.has_value() || unsubscribe.has_value())
+  {
+    if (subscribe.has_value())
+    {
+      for (auto current : subscribe.value())
+      {
+        room_->Subscribe(shared_from_this(), std::string(current));
+      }
+    }
+
+    if (unsubscribe.has_value())
+    {
+      for (auto current : unsubscribe.value())
+      {
+        room_->Unsubscribe(shared_from_this(), std::string(current));
+      }
+    }
+    Debug("ParseIncoming()", "updated subscriptions");
+
+    return nullptr;
+  }
+
+  auto author = parser.GetAuthor();
+  auto text = parser.GetContent();
+  auto client = parser.GetClient();
+  if (!author.has_value() || !text.has_value() || !client.has_value())
+  {
+    Debug("ParseIncoming()", "rejected, not an envelope");
+    return nullptr;
+  }
+
+  MessageFormatter::Message envelope {
+    std::string(author.value()),
+    std::string(text.value()),
+    std::string(client.value())};
+
+  // the views are copied out, so the text can move into the message
+  return ChatMessage::Create(std::move(envelope), std::move(content));
+}
+
 awaitable<void> ClientChatSession::Writer()
 {
   Debug("Writer()");
 
+  // the batch keeps the messages alive until their frames are on the wire,
+  // all three are reused between iterations
+  std::vector<ChatMessagePtr> batch;
+  std::vector<FrameHeader> headers;
+  std::vector<asio::const_buffer> buffers;
+  // never reallocates within a batch, so the buffers can point into it
+  headers.reserve(WRITE_BATCH_MAX);
+  // the previous batch was full, so more messages are likely on the way
+  bool under_load = false;
+
   try
   {
     while (socket_.is_open())
@@ -87,20 +179,61 @@ awaitable<void> ClientChatSession::Writer()
       if (write_messages_.empty())
       {
         Debug("Writer()", "is empty");
+        under_load = false;
 
         boost::system::error_code ec;
         co_await timer_.async_wait(asio::redirect_error(use_awaitable, ec));
         Debug("Writer()", "done waiting");
+        continue;
       }
-      else
+
+      if (under_load && write_messages_.size() < WRITE_BATCH_MAX)
       {
-        Debug("Writer()", "is not empty");
+        co_await Linger();
+      }
 
-        co_await socket_.async_write(asio::buffer(write_messages_.front()),
-                                     use_awaitable);
+      const std::size_t count =
+        std::min<std::size_t>(write_messages_.size(), WRITE_BATCH_MAX);
+      under_load = count == WRITE_BATCH_MAX;
+
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        batch.push_back(std::move(write_messages_.front()));
         write_messages_.pop_front();
-        Debug("Writer()", "message written");
+        const ChatMessage &message = *batch.back();
+        queued_bytes_ -= message.Size();
+        payload_bytes.Add(message.Size());
+
+        // one buffer shared with every other receiver, or a header of this
+        // session's own in front of the payload
+        if (const std::string *frame = SharedFrame(message))
+        {
+          buffers.push_back(asio::buffer(*frame));
+        }
+        else
+        {
+          headers.emplace_back(FrameOpcode::text, message.Size());
+          buffers.push_back(headers.back().Buffer());
+          buffers.push_back(message.Buffer());
+        }
       }
+
+      WatchForStall();
+      wire_bytes.Add(asio::buffer_size(buffers));
+      co_await socket_.next_layer().async_write_frames(buffers, use_awaitable);
+      stall_timer_.cancel();
+      Debug("Writer()", "batch written: {}", count);
+
+      messages_out.Add(count);
+      const auto written = std::chrono::steady_clock::now();
+      for (const ChatMessagePtr &message : batch)
+      {
+        delivery_latency.RecordSince(message->Created(), written);
+      }
+
+      batch.clear();
+      headers.clear();
+      buffers.clear();
     }
   }
   catch (std::exception &e)
@@ -111,14 +244,144 @@ awaitable<void> ClientChatSession::Writer()
   }
 }
 
+auto ClientChatSession::SharedFrame(const ChatMessage &message) const
+  -> const std::string*
+{
+  if (deflate_window_bits_ != 0 && message.Size() >= DEFLATE_MIN_BYTES)
+  {
+    const std::string &deflated = message.DeflatedFrame(deflate_window_bits_);
+    if (!deflated.empty())
+    {
+      return &deflated;
+    }
+  }
+
+  return PREFRAMED_BROADCAST ? &message.Frame() : nullptr;
+}
+
+awaitable<void> ClientChatSession::Linger()
+{
+  if (WRITE_LINGER_US == 0)
+  {
+    co_return;
+  }
+
+  lingering_ = true;
+  timer_.expires_after(std::chrono::microseconds(WRITE_LINGER_US));
+
+  boost::system::error_code ec;
+  co_await timer_.async_wait(asio::redirect_error(use_awaitable, ec));
+  Debug("Linger()", "queued: {}", write_messages_.size());
+
+  lingering_ = false;
+  timer_.expires_at(std::chrono::steady_clock::time_point::max());
+}
+
 void ClientChatSession::DeliverMessage(
   [[maybe_unused]] const ChatRoomParticipantPtr &participant,
-  const std::string &message)
+  const ChatMessagePtr &message)
 {
   Debug("deliver_message()");
 
+  asio::post(
+    strand_,
+    RecycledHandler(
+      [self = shared_from_this(), message] { self->Enqueue(message); }));
+}
+
+void ClientChatSession::Enqueue(const ChatMessagePtr &message)
+{
+  if (stopping_)
+  {
+    return;
+  }
+
+  const auto is_full = [this](u64 incoming_bytes) {
+    return write_messages_.size() >= SESSION_QUEUE_MESSAGES ||
+           queued_bytes_ + incoming_bytes > SESSION_QUEUE_BYTES;
+  };
+
+  if (is_full(message->Size()))
+  {
+    switch (SLOW_CONSUMER_POLICY)
+    {
+    case SlowConsumerPolicy::drop_newest:
+      CountDropped();
+      return;
+
+    case SlowConsumerPolicy::drop_oldest:
+      while (!write_messages_.empty() && is_full(message->Size()))
+      {
+        queued_bytes_ -= write_messages_.front()->Size();
+        write_messages_.pop_front();
+        CountDropped();
+      }
+
+      // doesn't fit even on its own
+      if (is_full(message->Size()))
+      {
+        CountDropped();
+        return;
+      }
+      break;
+
+    case SlowConsumerPolicy::disconnect:
+      Print(
+        "Enqueue()",
+        "slow consumer, queued: {} messages {} bytes, disconnecting",
+        write_messages_.size(),
+        queued_bytes_);
+      total_slow_disconnects.Add();
+      Stop({beast::websocket::close_code::try_again_later});
+      return;
+    }
+  }
+
   write_messages_.push_back(message);
-  timer_.cancel_one();
+  queued_bytes_ += message->Size();
+  queue_depth.Record(write_messages_.size());
+
+  if (!lingering_ || write_messages_.size() >= WRITE_BATCH_MAX)
+  {
+    timer_.cancel_one();
+  }
+}
+
+void ClientChatSession::CountDropped()
+{
+  ++dropped_messages_;
+  total_dropped_messages.Add();
+
+  // 1, 2, 4, 8... so a stuck client doesn't flood the log as well
+  if (std::has_single_bit(dropped_messages_))
+  {
+    Print("CountDropped()", "slow consumer, dropped: {}", dropped_messages_);
+  }
+}
+
+void ClientChatSession::WatchForStall()
+{
+  if (WRITE_STALL_TIMEOUT_MS == 0)
+  {
+    return;
+  }
+
+  stall_timer_.expires_after(std::chrono::milliseconds(WRITE_STALL_TIMEOUT_MS));
+  stall_timer_.async_wait(
+    [weak = weak_from_this()](boost::system::error_code ec) {
+      auto self = weak.lock();
+      if (ec || !self)
+      {
+        return;
+      }
+
+      self->Print("WatchForStall()", "write stalled, disconnecting");
+      total_write_stalls.Add();
+
+      // a close frame would only queue up behind the stuck write, so the
+      // socket goes away and the write fails instead
+      beast::get_lowest_layer(self->socket_).close(ec);
+    });
 }
 
 void ClientChatSession::Stop(
@@ -126,48 +389,156 @@ void ClientChatSession::Stop(
 {
   Debug("Stop()");
 
+  if (stopping_)
+  {
+    return;
+  }
+  stopping_ = true;
+
   room_->Leave(shared_from_this());
-  socket_.close(reason);
   timer_.cancel();
+  stall_timer_.cancel();
+
+  if (dropped_messages_ != 0)
+  {
+    Print("Stop()", "dropped messages: {}", dropped_messages_);
+  }
+
+  // the close frame has to go through the gate like every other frame, and
+  // it's the last one, a batch still waiting for the gate is dropped
+  socket_.next_layer().Seal();
+  co_spawn(
+    socket_.get_executor(),
+    [self = shared_from_this(), reason]() -> awaitable<void> {
+      boost::system::error_code ec;
+      co_await self->socket_.async_close(
+        reason,
+        asio::redirect_error(use_awaitable, ec));
+      self->Debug("Stop()", "closed: {}", ec.message());
+    },
+    detached);
 }
 
 Server::Server(
-  asio::io_context &io,
-   const std::shared_ptr<ThreadSafeChatRoom> &room)
-  : io_context_(io),
+  IoContextPool &pool,
+  const std::shared_ptr<ThreadSafeChatRoom> &room)
+  : pool_(pool),
     room_(room)
 {
   Debug("Constructor");
 
-  co_spawn(
-    io_context_,
-    DealWithAccepting({io_context_, {tcp::v4(), PORT}}),
-    detached);
+  // a single acceptor keeps PORT to itself. Several share it, and a port
+  // already taken would be shared with whoever took it, binding once without
+  // SO_REUSEPORT first fails with EADDRINUSE instead
+  const bool reuse_port = pool_.Size() > 1;
+  if (reuse_port)
+  {
+    tcp::acceptor probe(pool_.GetContext(0));
+    probe.open(tcp::v4());
+    probe.set_option(tcp::acceptor::reuse_address(true));
+    probe.bind({tcp::v4(), PORT});
+  }
+  for (std::size_t i = 0; i < pool_.Size(); ++i)
+  {
+    auto &io = pool_.GetContext(i);
+    co_spawn(io, DealWithAccepting(MakeAcceptor(io, reuse_port)), detached);
+  }
   Debug("Constructor", "spawned deal_with_accepting");
 
-  Print("Constructor", "Server Running on Port: {}", PORT);
+  Print(
+    "Constructor",
+    "Server Running on Port: {} with {} acceptors",
+    PORT,
+    pool_.Size());
+}
+
+auto Server::MakeAcceptor(asio::io_context &io, bool reuse_port)
+  -> tcp::acceptor
+{
+  using reuse_port_option =
+    asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+  tcp::acceptor acceptor(io);
+  acceptor.open(tcp::v4());
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+  if (reuse_port)
+  {
+    acceptor.set_option(reuse_port_option(true));
+  }
+  acceptor.bind({tcp::v4(), PORT});
+  acceptor.listen(static_cast<i32>(ACCEPT_BACKLOG));
+
+  // only the synchronous accepts of a batch, they must never block
+  acceptor.non_blocking(true);
+  return acceptor;
 }
 
 awaitable<void> Server::DealWithAccepting(tcp::acceptor acceptor)
 {
   Debug("DealWithAccepting()");
 
+  // the sessions stay on this context, every one on its own strand
+  auto &io = static_cast<asio::io_context&>(
+    acceptor.get_executor().context());
+
+  asio::steady_timer backoff(io);
   while (true)
   {
     Debug("DealWithAccepting()", "iteration start");
 
-    auto tcp_socket = co_await acceptor.async_accept(use_awaitable);
+    bool failed = false;
+    try
+    {
+      StartSession(co_await acceptor.async_accept(
+        asio::make_strand(io),
+        use_awaitable));
 
-    std::shared_ptr<ClientChatSession> session =
-      std::make_shared<ClientChatSession>(
-        std::move(tcp_socket),
-        room_);
+      u32 accepted = 1;
+      for (; accepted < ACCEPT_BATCH_MAX; ++accepted)
+      {
+        boost::system::error_code ec;
+        auto tcp_socket = acceptor.accept(asio::make_strand(io), ec);
+        if (ec)
+        {
+          // would_block once the queue is empty, anything else shows up
+          // again on the next async_accept
+          break;
+        }
+
+        StartSession(std::move(tcp_socket));
+      }
+
+      accept_batch.Record(accepted);
+    }
+    catch (std::exception &e)
+    {
+      // e.g. EMFILE, the listener is still fine once descriptors free up
+      Print("DealWithAccepting()", "caught: {}", e.what());
+      failed = true;
+    }
 
-    co_spawn(
-      io_context_,
-      [self = session] { return self->Acceptor(); },
-      detached);
-    Debug("DealWithAccepting()", "started session");
+    if (failed)
+    {
+      boost::system::error_code ec;
+      backoff.expires_after(std::chrono::milliseconds(100));
+      co_await backoff.async_wait(asio::redirect_error(use_awaitable, ec));
+    }
   }
 }
 
+void Server::StartSession(ClientChatSession::StrandSocket &&tcp_socket)
+{
+  auto strand = tcp_socket.get_executor();
+
+  std::shared_ptr<ClientChatSession> session =
+    std::allocate_shared<ClientChatSession>(
+      RecyclingAllocator<ClientChatSession>(),
+      std::move(tcp_socket),
+      room_);
+
+  co_spawn(
+    strand,
+    [self = session] { return self->Acceptor(); },
+    detached);
+  Debug("StartSession()", "started session");
+}
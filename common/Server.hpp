@@ -2,7 +2,11 @@
 
 #include "common.hpp"
 #include "ChatRoom.hpp"
+#include "GatedStream.hpp"
+#include "IoContextPool.hpp"
 #include "Logger.hpp"
+#include "Metrics.hpp"
+#include "RecyclingPool.hpp"
 
 namespace bridge
 {
@@ -13,15 +17,75 @@ class ClientChatSession
     public std::enable_shared_from_this<ClientChatSession>,
     private Logger<CLIENTCHATSESSION_STR>
 {
-  using WebSocket = beast::websocket::stream<asio::ip::tcp::socket>;
+public:
+  using Strand = asio::strand<asio::io_context::executor_type>;
+  // what the acceptor hands out when it's given a strand
+  using StrandSocket = asio::ip::tcp::socket::rebind_executor<Strand>::other;
+
+private:
+  using WebSocket =
+    beast::websocket::stream<GatedStream<asio::ip::tcp::socket>>;
 
+  // the socket's own, as a concrete type it keeps the allocator of the
+  // handlers posted to it
+  Strand strand_;
+  // the socket is bound to the strand, so is everything else in the session
   WebSocket socket_;
   asio::steady_timer timer_;
+  // fires when a single batch takes longer than WRITE_STALL_TIMEOUT_MS
+  asio::steady_timer stall_timer_;
   std::shared_ptr<ThreadSafeChatRoom> room_;
-  std::deque<std::string> write_messages_;
+  // bounded by SESSION_QUEUE_MESSAGES and SESSION_QUEUE_BYTES
+  std::deque<ChatMessagePtr> write_messages_;
+  u64 queued_bytes_ = 0;
+  u64 dropped_messages_ = 0;
+  // the server_max_window_bits agreed on in the handshake, 0 when the client
+  // didn't agree on permessage-deflate
+  u8 deflate_window_bits_ = 0;
+  // while lingering the writer is only woken up by a full batch
+  bool lingering_ = false;
+  bool stopping_ = false;
+
 public:
+  // totals over all the sessions
+  static inline Counter total_dropped_messages {
+    "bridge_session_dropped_messages_total",
+    "Messages dropped by SLOW_CONSUMER_POLICY"};
+  static inline Counter total_slow_disconnects {
+    "bridge_session_slow_disconnects_total",
+    "Sessions disconnected for being slow consumers"};
+  static inline Counter total_write_stalls {
+    "bridge_session_write_stalls_total",
+    "Sessions disconnected after a stalled write"};
+  static inline Counter messages_in {
+    "bridge_messages_in_total",
+    "Messages handed to the room, per participant type",
+    "participant=\"client\""};
+  static inline Counter messages_out {
+    "bridge_messages_out_total",
+    "Messages written out, per participant type",
+    "participant=\"client\""};
+  static inline Counter payload_bytes {
+    "bridge_session_payload_bytes_total",
+    "Payload bytes of the frames written, before permessage-deflate"};
+  static inline Counter wire_bytes {
+    "bridge_session_wire_bytes_total",
+    "Bytes of the frames written, headers included, as they went on the wire"};
+  static inline Histogram queue_depth {
+    "bridge_session_queue_depth",
+    "write_messages_ of a session as a message is queued",
+    1,
+    1 << 20};
+  static inline Histogram delivery_latency {
+    "bridge_reader_to_writer_seconds",
+    "From a message entering the bridge to its frame being written",
+    1'000,
+    30'000'000'000,
+    1e-9};
+
+  // Made with std::allocate_shared on a RecyclingAllocator
   [[nodiscard]] ClientChatSession(
-    asio::ip::tcp::socket &&tcp_socket,
+    StrandSocket &&tcp_socket,
     const std::shared_ptr<ThreadSafeChatRoom> &room);
 
   ~ClientChatSession();
@@ -32,13 +96,38 @@ public:
 private:
   awaitable<void> Reader();
 
+  // Parses the message once into its envelope, applies {"subscribe"} and
+  // {"unsubscribe"} control messages, returns nullptr for those and for
+  // anything that isn't a valid envelope
+  auto ParseIncoming(std::string &&content) -> ChatMessagePtr;
+
+  // Drains up to WRITE_BATCH_MAX messages and writes them as one gather write
+  // of raw frames, beast's own frames are serialized by the GatedStream. The
+  // frames are the ones the message shares with every receiver, unless
+  // PREFRAMED_BROADCAST is off
   awaitable<void> Writer();
 
-  // This method is called when there's a
-  // ChatMessage to be delivered to this client
+  // The message's frame shared by every receiver with the same settings,
+  // deflated if that was agreed on and worth it. nullptr when this session
+  // has to frame the json itself
+  auto SharedFrame(const ChatMessage &message) const -> const std::string*;
+
+  // Under load waits up to WRITE_LINGER_US for the batch to fill up
+  awaitable<void> Linger();
+
+  // Queues a message on the strand, applies SLOW_CONSUMER_POLICY when full
+  void Enqueue(const ChatMessagePtr &message);
+
+  void CountDropped();
+
+  // Arms stall_timer_ for the batch that's about to be written
+  void WatchForStall();
+
+  // This method is called when there's a ChatMessage to be delivered to this
+  // client, it may be called from any thread so it hops onto the strand
   void DeliverMessage(
     [[maybe_unused]] const ChatRoomParticipantPtr &participant,
-    const std::string &message) override;
+    const ChatMessagePtr &message) override;
 
 public:
   // Use this to gracefully stop the connection with any reason
@@ -46,18 +135,39 @@ public:
 };
 
 constexpr char SERVER_STR[] = "Server";
+// Listens on PORT with one SO_REUSEPORT acceptor per context of the pool, so
+// the kernel spreads new connections over them instead of queueing them all
+// behind a single accept loop. PORT must be free, even with SO_REUSEPORT
+// another process can't join in, and a pool of one context listens without
+// it. A session runs on the context that accepted it
 class Server
   : private Logger<SERVER_STR>
 {
-  asio::io_context& io_context_;
+  IoContextPool& pool_;
   std::shared_ptr<ThreadSafeChatRoom> room_;
+
+  static inline Histogram accept_batch {
+    "bridge_accept_batch_size",
+    "Connections taken off a listener per wake up",
+    1,
+    1 << 10};
 public:
   [[nodiscard]] Server(
-    asio::io_context &io,
+    IoContextPool &pool,
     const std::shared_ptr<ThreadSafeChatRoom> &room);
 
 private:
+  // Bound and listening on PORT. With reuse_port next to the other contexts'
+  // acceptors, without it a second process on PORT fails with EADDRINUSE
+  [[nodiscard]] static auto MakeAcceptor(asio::io_context &io, bool reuse_port)
+    -> asio::ip::tcp::acceptor;
+
+  // Waits for a connection, then takes up to ACCEPT_BATCH_MAX - 1 more that
+  // are already queued without waiting again. A failed accept is logged and
+  // retried after a short pause, it never ends the loop
   awaitable<void> DealWithAccepting(asio::ip::tcp::acceptor acceptor);
+
+  void StartSession(ClientChatSession::StrandSocket &&tcp_socket);
 };
 
 } // bridge
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace bridge
+{
+
+enum class FrameOpcode : u8
+{
+  text = 0x1,
+  binary = 0x2
+};
+
+// Header of an unmasked server to client frame, see RFC 6455 section 5.2,
+// used to put whole frames on the wire without going through beast
+class FrameHeader
+{
+  std::array<u8, 10> bytes_ {};
+  u8 size_ = 0;
+
+public:
+  FrameHeader() = default;
+
+  FrameHeader(
+    FrameOpcode opcode,
+    std::size_t payload_size,
+    bool rsv1 = false)
+  {
+    // always a single final frame
+    bytes_[0] = 0x80 | (rsv1 ? 0x40 : 0x00) | static_cast<u8>(opcode);
+
+    if (payload_size <= 125)
+    {
+      bytes_[1] = static_cast<u8>(payload_size);
+      size_ = 2;
+    }
+    else if (payload_size <= 0xffff)
+    {
+      bytes_[1] = 126;
+      bytes_[2] = static_cast<u8>(payload_size >> 8);
+      bytes_[3] = static_cast<u8>(payload_size);
+      size_ = 4;
+    }
+    else
+    {
+      bytes_[1] = 127;
+      for (u8 i = 0; i < 8; ++i)
+      {
+        bytes_[2 + i] = static_cast<u8>(payload_size >> (56 - 8 * i));
+      }
+      size_ = 10;
+    }
+  }
+
+  [[nodiscard]] auto Buffer() const -> asio::const_buffer
+  {
+    return asio::buffer(bytes_.data(), size_);
+  }
+
+  // The header and the payload in one buffer, for a frame that's written to
+  // many sockets as is
+  [[nodiscard]] static auto Encode(
+    FrameOpcode opcode,
+    std::string_view payload,
+    bool rsv1 = false) -> std::string
+  {
+    const FrameHeader header(opcode, payload.size(), rsv1);
+
+    std::string frame;
+    frame.reserve(header.size_ + payload.size());
+    frame.append(reinterpret_cast<const char*>(header.bytes_.data()),
+                 header.size_);
+    frame.append(payload);
+    return frame;
+  }
+};
+
+} // bridge
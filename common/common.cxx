@@ -0,0 +1,4 @@
+// The definitions of the globals in common.hpp, part of the library so
+// everything linking it gets them
+#define COMMON_IMPLEMENT_EXTERNS
+#include "common.hpp"
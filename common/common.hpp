@@ -1,12 +1,19 @@
 #ifndef COMMON_HEADER_
 
 #include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <atomic>
+#include <bit>
 #include <thread>
 #include <deque>
 #include <set>
 #include <map>
+#include <optional>
+#include <unordered_map>
 #include <fstream>
 #include <ranges>
+#include <span>
 #include <vector>
 
 #define BOOST_ASIO_HAS_CO_AWAIT
@@ -39,11 +46,135 @@ using u64 = uint64_t;
 
 extern u16 PORT;
 extern char* TOKEN;
+extern u32 IO_THREADS;
+extern u32 IO_CONTEXTS;
+extern u32 WRITE_BATCH_MAX;
+extern u32 WRITE_LINGER_US;
+extern u32 ROOM_QUEUE_CAPACITY;
+
+// What a session does once its outbound queue is full
+enum class SlowConsumerPolicy : u8
+{
+  drop_oldest,
+  drop_newest,
+  disconnect
+};
+
+extern u32 SESSION_QUEUE_MESSAGES;
+extern u64 SESSION_QUEUE_BYTES;
+extern SlowConsumerPolicy SLOW_CONSUMER_POLICY;
+extern u32 WRITE_STALL_TIMEOUT_MS;
+extern u32 JOURNAL_SYNC_MS;
+extern u32 JOURNAL_COMPACT_RECORDS;
+extern u16 METRICS_PORT;
+extern u32 DISCORD_COALESCE_MS;
+extern u32 DISCORD_MAX_RETRIES;
+extern u32 DISCORD_QUEUE_MAX;
+extern u32 DEFLATE_LEVEL;
+extern u32 DEFLATE_MIN_BYTES;
+extern bool PREFRAMED_BROADCAST;
+extern u32 ACCEPT_BACKLOG;
+extern u32 ACCEPT_BATCH_MAX;
+extern u64 RECYCLING_POOL_BYTES;
+
+// Reads an optional numeric environment variable
+template <typename T>
+inline T GetEnvOr(const char* name, T default_value)
+{
+  const char* value = std::getenv(name);
+  if (value == nullptr || *value == '\0')
+  {
+    return default_value;
+  }
+
+  return static_cast<T>(std::strtoull(value, nullptr, 10));
+}
+
+// drop_oldest, drop_newest or disconnect, anything else is drop_oldest
+inline SlowConsumerPolicy GetSlowConsumerPolicy()
+{
+  const char* value = std::getenv("BRIDGE_SLOW_CONSUMER_POLICY");
+  const std::string_view policy = value == nullptr ? "" : value;
+
+  if (policy == "drop_newest")
+  {
+    return SlowConsumerPolicy::drop_newest;
+  }
+  if (policy == "disconnect")
+  {
+    return SlowConsumerPolicy::disconnect;
+  }
+  return SlowConsumerPolicy::drop_oldest;
+}
 
 inline void AccuireEnvs()
 {
-  PORT = std::atoi(std::getenv("BRIDGE_PORT"));
+  // the benches take theirs from the command line, unset is 0 for them
+  PORT = GetEnvOr<u16>("BRIDGE_PORT", 0);
   TOKEN = std::getenv("BRIDGE_BOT_TOKEN");
+
+  IO_THREADS = GetEnvOr<u32>(
+    "BRIDGE_IO_THREADS",
+    std::max(1u, std::thread::hardware_concurrency()));
+  // one per thread by default, every context accepts on its own
+  // SO_REUSEPORT listener and a connection stays on the thread that
+  // accepted it
+  IO_CONTEXTS = GetEnvOr<u32>("BRIDGE_IO_CONTEXTS", IO_THREADS);
+
+  ACCEPT_BACKLOG = GetEnvOr<u32>("BRIDGE_ACCEPT_BACKLOG", SOMAXCONN);
+  // connections taken off a listener per wake up
+  ACCEPT_BATCH_MAX = std::max(1u, GetEnvOr<u32>("BRIDGE_ACCEPT_BATCH_MAX", 16));
+
+  // 32 frames are 64 buffers, which is what asio hands to a single writev
+  WRITE_BATCH_MAX = std::max(1u, GetEnvOr<u32>("BRIDGE_WRITE_BATCH_MAX", 32));
+  WRITE_LINGER_US = GetEnvOr<u32>("BRIDGE_WRITE_LINGER_US", 100);
+
+  // rounded up to a power of two
+  ROOM_QUEUE_CAPACITY = GetEnvOr<u32>("BRIDGE_ROOM_QUEUE_CAPACITY", 65536);
+
+  SESSION_QUEUE_MESSAGES = std::max(
+    1u,
+    GetEnvOr<u32>("BRIDGE_SESSION_QUEUE_MESSAGES", 4096));
+  SESSION_QUEUE_BYTES = GetEnvOr<u64>("BRIDGE_SESSION_QUEUE_BYTES", 4 << 20);
+  SLOW_CONSUMER_POLICY = GetSlowConsumerPolicy();
+  // 0 turns the stall detection off
+  WRITE_STALL_TIMEOUT_MS =
+    GetEnvOr<u32>("BRIDGE_WRITE_STALL_TIMEOUT_MS", 10000);
+
+  // at most one fsync of the binding journal per interval
+  JOURNAL_SYNC_MS = GetEnvOr<u32>("BRIDGE_JOURNAL_SYNC_MS", 20);
+  JOURNAL_COMPACT_RECORDS = std::max(
+    1u,
+    GetEnvOr<u32>("BRIDGE_JOURNAL_COMPACT_RECORDS", 4096));
+
+  // 0 leaves the /metrics listener off
+  METRICS_PORT = GetEnvOr<u16>("BRIDGE_METRICS_PORT", 0);
+
+  // how long messages for a channel are collected into one Discord message
+  DISCORD_COALESCE_MS = GetEnvOr<u32>("BRIDGE_DISCORD_COALESCE_MS", 250);
+
+  // 5xx and failed connections, rate limits are waited out and not counted
+  DISCORD_MAX_RETRIES = GetEnvOr<u32>("BRIDGE_DISCORD_MAX_RETRIES", 5);
+  // messages a channel holds for Discord, past that the oldest one behind
+  // the one up next is dropped
+  DISCORD_QUEUE_MAX = std::max(
+    1u,
+    GetEnvOr<u32>("BRIDGE_DISCORD_QUEUE_MAX", 256));
+
+  // permessage-deflate for the clients that offer it, 0 doesn't negotiate it
+  DEFLATE_LEVEL = std::min(9u, GetEnvOr<u32>("BRIDGE_DEFLATE_LEVEL", 1));
+  // smaller messages go out uncompressed, there's little to win
+  DEFLATE_MIN_BYTES = GetEnvOr<u32>("BRIDGE_DEFLATE_MIN_BYTES", 128);
+
+  // the room frames a message once for every client, 0 makes every session
+  // put its own header in front of the payload
+  PREFRAMED_BROADCAST =
+    GetEnvOr<u32>("BRIDGE_PREFRAMED_BROADCAST", 1) != 0;
+
+  // per size class, what sessions and posted handlers keep around for reuse,
+  // 0 takes every one of them from the heap
+  RECYCLING_POOL_BYTES =
+    GetEnvOr<u64>("BRIDGE_RECYCLING_POOL_BYTES", 1 << 20);
 }
 
 namespace beast = boost::beast;
@@ -59,6 +190,27 @@ using ptree = boost::property_tree::ptree;
 
 u16 PORT;
 char* TOKEN;
+u32 IO_THREADS;
+u32 IO_CONTEXTS;
+u32 WRITE_BATCH_MAX;
+u32 WRITE_LINGER_US;
+u32 ROOM_QUEUE_CAPACITY;
+u32 SESSION_QUEUE_MESSAGES;
+u64 SESSION_QUEUE_BYTES;
+SlowConsumerPolicy SLOW_CONSUMER_POLICY;
+u32 WRITE_STALL_TIMEOUT_MS;
+u32 JOURNAL_SYNC_MS;
+u32 JOURNAL_COMPACT_RECORDS;
+u16 METRICS_PORT;
+u32 DISCORD_COALESCE_MS;
+u32 DISCORD_MAX_RETRIES;
+u32 DISCORD_QUEUE_MAX;
+u32 DEFLATE_LEVEL;
+u32 DEFLATE_MIN_BYTES;
+bool PREFRAMED_BROADCAST;
+u32 ACCEPT_BACKLOG;
+u32 ACCEPT_BATCH_MAX;
+u64 RECYCLING_POOL_BYTES;
 
 #undef COMMON_IMPLEMENT_EXTERNS
 #endif // COMMON_IMPLEMENT_EXTERNS
@@ -10,6 +10,17 @@ namespace detail
 
 struct Failure {};
 
+// Lets the unordered containers keyed by std::string look up string_views
+struct StringHash
+{
+  using is_transparent = void;
+
+  [[nodiscard]] auto operator()(std::string_view value) const -> std::size_t
+  {
+    return std::hash<std::string_view> {}(value);
+  }
+};
+
 template <typename T>
 using CheckedResult = outcome::checked<T, Failure>;
 
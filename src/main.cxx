@@ -1,29 +1,168 @@
-#define COMMON_IMPLEMENT_EXTERNS
 #include "common/common.hpp"
 
 #include "common/Logger.hpp"
+#include "common/IoContextPool.hpp"
 #include "common/ChatRoom.hpp"
 #include "common/Server.hpp"
+#include "common/MetricsServer.hpp"
 #include "bot/Bot.hpp"
+#include "bot/DppGateway.hpp"
 
+#ifdef BRIDGE_IO_URING
+#include <liburing.h>
+#include <unistd.h>
+#endif // BRIDGE_IO_URING
 
-auto main() -> i32
+namespace
 {
+
+#ifdef BRIDGE_IO_URING
+// Whether the kernel hands out a ring that takes every operation Asio's
+// backend submits. There's no ring before 5.1, with kernel.io_uring_disabled
+// set or under a seccomp profile that blocks it, and on the 5.x kernels
+// before 5.6 there's no probe either, which came after the last of these
+auto IoUringAvailable() -> bool
+{
+  io_uring_probe *probe = io_uring_get_probe();
+  if (probe == nullptr)
+  {
+    global_logger.Print(
+      "IoUringAvailable()",
+      "no io_uring, or a kernel too old to probe it");
+    return false;
+  }
+
+  // sockets, timers and cancelling what's outstanding
+  struct Operation
+  {
+    i32 opcode;
+    std::string_view name;
+  };
+  constexpr std::array<Operation, 9> operations {{
+    {IORING_OP_NOP, "nop"},
+    {IORING_OP_READV, "readv"},
+    {IORING_OP_WRITEV, "writev"},
+    {IORING_OP_POLL_ADD, "poll_add"},
+    {IORING_OP_SENDMSG, "sendmsg"},
+    {IORING_OP_RECVMSG, "recvmsg"},
+    {IORING_OP_ACCEPT, "accept"},
+    {IORING_OP_TIMEOUT, "timeout"},
+    {IORING_OP_ASYNC_CANCEL, "async_cancel"}}};
+
+  bool supported = true;
+  for (const Operation &operation : operations)
+  {
+    if (!io_uring_opcode_supported(probe, operation.opcode))
+    {
+      global_logger.Print(
+        "IoUringAvailable()",
+        "io_uring lacks {}",
+        operation.name);
+      supported = false;
+    }
+  }
+
+  io_uring_free_probe(probe);
+  return supported;
+}
+
+// This binary can't go back to epoll, it replaces itself with the epoll
+// build, BRIDGE_EPOLL_SERVER or the server next to it. Only returns if that
+// fails
+void FallBackToEpoll(char **argv)
+{
+  std::string path;
+  if (const char *configured = std::getenv("BRIDGE_EPOLL_SERVER"))
+  {
+    path = configured;
+  }
+  else
+  {
+    std::array<char, 4096> self {};
+    if (readlink("/proc/self/exe", self.data(), self.size() - 1) < 0)
+    {
+      return;
+    }
+
+    path = std::string(self.data());
+    path = path.substr(0, path.rfind('/') + 1) + "server";
+  }
+
+  global_logger.Print("FallBackToEpoll()", "running {} instead", path);
+  // execv runs no exit handlers, what's still queued would be lost, and
+  // from here on records are written right away
+  bridge::LogSink::Instance().Flush();
+  execv(path.c_str(), argv);
+  global_logger.Print(
+    "FallBackToEpoll()",
+    "execv failed: {}",
+    std::strerror(errno));
+}
+#endif // BRIDGE_IO_URING
+
+// Re-reads the log levels on every SIGHUP, e.g. to trace one domain on a
+// running process
+void ReloadLogLevelsOnHangup(asio::signal_set &signals)
+{
+  signals.async_wait([&signals](beast::error_code ec, i32) {
+    if (ec)
+    {
+      return;
+    }
+
+    const bool loaded = bridge::LogLevels::Load();
+    global_logger.Print("main()", "log levels reloaded, ok: {}", loaded);
+    ReloadLogLevelsOnHangup(signals);
+  });
+}
+
+} // namespace
+
+auto main([[maybe_unused]] i32 argc, [[maybe_unused]] char **argv) -> i32
+{
+#ifdef BRIDGE_IO_URING
+  // BRIDGE_IO_URING=0 picks epoll without building again
+  if (GetEnvOr<u32>("BRIDGE_IO_URING", 1) == 0 || !IoUringAvailable())
+  {
+    FallBackToEpoll(argv);
+    return 1;
+  }
+  global_logger.Print("main()", "running on io_uring");
+#endif // BRIDGE_IO_URING
+
   AccuireEnvs();
+  if (!bridge::LogLevels::Load())
+  {
+    global_logger.Print("main()", "log levels only partly applied");
+  }
 
-  asio::io_context io_context;
-  auto room = std::make_shared<bridge::ThreadSafeChatRoom>(io_context);
+  bridge::IoContextPool pool(IO_CONTEXTS, IO_THREADS);
+  auto room = std::make_shared<bridge::ThreadSafeChatRoom>(pool.GetContext(0));
 
   // make sure not to pass the bot to another thread, completely self contained
-  // if thread safety is needed use asio::post with the io_context in this scope
+  // if thread safety is needed use asio::post with the pool's contexts
   // also if you want to just turn it off and just have a simple ChatRoom, just
   // comment the 2 lines below :)
-  std::make_shared<bridge::BotChatSession>(room->shared_from_this())->Start();
+  std::make_shared<bridge::BotChatSession>(
+    room->shared_from_this(),
+    std::make_unique<bridge::DppGateway>(TOKEN),
+    pool.GetContext(0))->Start();
   global_logger.Print("main()", "Bot Running");
 
-  bridge::Server server(io_context, room->shared_from_this());
+  bridge::Server server(pool, room->shared_from_this());
+  global_logger.Print(
+    "main()",
+    "Running {} io threads on {} io contexts",
+    IO_THREADS,
+    IO_CONTEXTS);
+
+  // on its own thread, not the pool's
+  bridge::MetricsServer metrics(METRICS_PORT);
+
+  asio::signal_set hangup(pool.GetContext(0), SIGHUP);
+  ReloadLogLevelsOnHangup(hangup);
 
-  io_context.run();
+  pool.Run();
 
   return 0;
 }